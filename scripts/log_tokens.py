@@ -0,0 +1,246 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-3.0-only
+
+# Extracts the format strings of log calls (TRACE, DEBUG, INFO, WARN, ERROR)
+# for tokenized logging.
+#
+# The header maps each call site, by file and line, to the ID of its format
+# string and a spec of its arguments. It is used by common/log.h. Calls inside
+# macro definitions, or without a string literal format, are not tokenized and
+# still use printf.
+#
+# The dictionary maps each ID to its format string, and is used by the
+# console of dasharo_ectool to decode tokens. Each line is the ID, a tab, and
+# the format string, with backslash, tab, newline, carriage return, and
+# non-printable characters escaped as in C.
+#
+# Usage: log_tokens.py HEADER DICTIONARY SOURCE...
+
+import re
+import sys
+
+LOG_CALL = re.compile(r'\b(TRACE|DEBUG|INFO|WARN|ERROR)\s*\(')
+
+# Argument kinds, must match common/log.h
+LOG_ARG_CHAR = 'b'
+LOG_ARG_INT = 'i'
+LOG_ARG_LONG = 'l'
+LOG_ARG_LONG_LONG = 'q'
+LOG_ARG_POINTER = 'p'
+LOG_ARG_STRING = 's'
+
+CONVERSION = re.compile(r'%([-+ #0]*)(\d*)(?:\.(\d*))?(hh|h|ll|l|b)?([diuxXocsSp%])')
+
+ESCAPES = {
+    'n': '\n',
+    'r': '\r',
+    't': '\t',
+    '\\': '\\',
+    '"': '"',
+    "'": "'",
+    '0': '\0',
+}
+
+
+# Blank comments and the bodies of preprocessor directives, keeping lines and
+# string literals in place
+def strip(text: str) -> str:
+    out = []
+    i = 0
+    line_start = True
+    directive = False
+    while i < len(text):
+        c = text[i]
+        if c == '\n':
+            if not (directive and out and out[-1] == '\\'):
+                directive = False
+            line_start = True
+            out.append(c)
+            i += 1
+            continue
+        if line_start and c == '#':
+            directive = True
+        if not c.isspace():
+            line_start = False
+        if text.startswith('//', i):
+            while i < len(text) and text[i] != '\n':
+                i += 1
+            continue
+        if text.startswith('/*', i):
+            end = text.find('*/', i + 2)
+            end = len(text) if end < 0 else end + 2
+            out.extend(ch if ch == '\n' else ' ' for ch in text[i:end])
+            i = end
+            continue
+        if c in '"\'':
+            end = i + 1
+            while end < len(text) and text[end] != c:
+                end += 2 if text[end] == '\\' else 1
+            end = min(end + 1, len(text))
+            chunk = text[i:end]
+            out.extend(' ' * len(chunk) if directive else chunk)
+            i = end
+            continue
+        out.append(' ' if directive and c != '\\' else c)
+        i += 1
+    return ''.join(out)
+
+
+def unescape(literal: str) -> str:
+    out = []
+    i = 0
+    while i < len(literal):
+        c = literal[i]
+        if c != '\\':
+            out.append(c)
+            i += 1
+            continue
+        n = literal[i + 1]
+        if n == 'x':
+            m = re.match(r'[0-9a-fA-F]+', literal[i + 2:])
+            out.append(chr(int(m.group(0), 16)))
+            i += 2 + len(m.group(0))
+        elif n in '01234567' and n != '0' or re.match(r'0[0-7]', literal[i + 1:i + 3]):
+            m = re.match(r'[0-7]{1,3}', literal[i + 1:])
+            out.append(chr(int(m.group(0), 8)))
+            i += 1 + len(m.group(0))
+        else:
+            out.append(ESCAPES.get(n, n))
+            i += 2
+    return ''.join(out)
+
+
+def escape(s: str) -> str:
+    out = []
+    for c in s:
+        if c == '\\':
+            out.append('\\\\')
+        elif c == '\n':
+            out.append('\\n')
+        elif c == '\r':
+            out.append('\\r')
+        elif c == '\t':
+            out.append('\\t')
+        elif ord(c) < 0x20 or ord(c) >= 0x7F:
+            out.append('\\x{:02X}'.format(ord(c)))
+        else:
+            out.append(c)
+    return ''.join(out)
+
+
+# Kinds of the arguments used by a format string
+def spec(fmt: str) -> str:
+    kinds = []
+    for m in CONVERSION.finditer(fmt):
+        length, conversion = m.group(4), m.group(5)
+        if conversion == '%':
+            continue
+        if conversion in 'sS':
+            kinds.append(LOG_ARG_STRING)
+        elif conversion == 'p':
+            kinds.append(LOG_ARG_POINTER)
+        elif length == 'b':
+            kinds.append(LOG_ARG_CHAR)
+        elif length == 'll':
+            kinds.append(LOG_ARG_LONG_LONG)
+        elif length == 'l':
+            kinds.append(LOG_ARG_LONG)
+        else:
+            kinds.append(LOG_ARG_INT)
+    return ''.join(kinds)
+
+
+# Returns (first line, last line, format) of each tokenizable log call
+def calls(text: str):
+    for m in LOG_CALL.finditer(text):
+        # Format must be string literals only
+        i = m.end()
+        literals = []
+        while True:
+            while i < len(text) and text[i].isspace():
+                i += 1
+            if i >= len(text) or text[i] != '"':
+                break
+            end = i + 1
+            while text[end] != '"':
+                end += 2 if text[end] == '\\' else 1
+            literals.append(text[i + 1:end])
+            i = end + 1
+        if not literals or text[i] not in ',)':
+            continue
+
+        # Find closing parenthesis
+        depth = 1
+        while depth > 0 and i < len(text):
+            c = text[i]
+            if c in '"\'':
+                end = i + 1
+                while text[end] != c:
+                    end += 2 if text[end] == '\\' else 1
+                i = end
+            elif c == '(':
+                depth += 1
+            elif c == ')':
+                depth -= 1
+            i += 1
+
+        first = text.count('\n', 0, m.start()) + 1
+        last = text.count('\n', 0, i) + 1
+        yield first, last, unescape(''.join(literals))
+
+
+def file_key(path: str) -> str:
+    return re.sub(r'[^A-Za-z0-9_]', '_', path)
+
+
+def main(header: str, dictionary: str, sources: list[str]) -> None:
+    sites = []
+    for source in sources:
+        with open(source, encoding='utf-8') as f:
+            text = strip(f.read())
+        for first, last, fmt in calls(text):
+            sites.append((source, first, last, fmt))
+
+    ids = {fmt: i + 1 for i, fmt in enumerate(sorted({site[3] for site in sites}))}
+    if len(ids) > 0xFFFF:
+        sys.exit('too many log format strings: {}'.format(len(ids)))
+
+    lines = [
+        '// Generated by scripts/log_tokens.py, do not edit',
+        '',
+        '#ifndef _LOG_TOKENS_H',
+        '#define _LOG_TOKENS_H',
+        '',
+    ]
+    for source, first, last, fmt in sites:
+        # __LINE__ of a call spanning lines may be any of them
+        for line in range(first, last + 1):
+            lines.append('#define LOG_TOKEN_{}_{} ~, 1, {}, "{}"'.format(
+                file_key(source), line, ids[fmt], spec(fmt)))
+    lines += [
+        '',
+        '#endif // _LOG_TOKENS_H',
+    ]
+    write(header, '\n'.join(lines) + '\n')
+
+    write(dictionary, ''.join(
+        '{}\t{}\n'.format(i, escape(fmt)) for fmt, i in sorted(ids.items(), key=lambda x: x[1])
+    ))
+
+
+# Only write when changed, so sources are not rebuilt needlessly
+def write(path: str, data: str) -> None:
+    try:
+        with open(path, encoding='utf-8') as f:
+            if f.read() == data:
+                return
+    except FileNotFoundError:
+        pass
+    with open(path, 'w', encoding='utf-8') as f:
+        f.write(data)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 3:
+        sys.exit('usage: {} HEADER DICTIONARY SOURCE...'.format(sys.argv[0]))
+    main(sys.argv[1], sys.argv[2], sys.argv[3:])
@@ -5,7 +5,19 @@
 
 #include <stdint.h>
 
+// Timer 0 runs at 9.2 MHz / 12, and overflows once per millisecond
+#define TIME_TICKS_PER_MS 767
+
 void time_init(void);
+// Get the time in milliseconds
 uint32_t time_get(void);
+// Get the time in timer 0 ticks, wraps after about 93 minutes
+uint32_t time_get_ticks(void);
+// Get the time in microseconds, wraps after about 71 minutes
+uint32_t time_get_us(void);
+// Get the timer 0 ticks elapsed since a time_get_ticks() value
+uint32_t time_elapsed_ticks(uint32_t start);
+// Convert timer 0 ticks to microseconds
+uint32_t time_ticks_to_us(uint32_t ticks);
 
 #endif // _ARCH_TIME_H
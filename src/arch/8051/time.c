@@ -41,3 +41,51 @@ void time_init(void) __critical {
 uint32_t time_get(void) __critical {
     return time_overflows;
 }
+
+// Read the millisecond count and the timer 0 ticks since then, consistently
+static void time_read(uint32_t *ms, uint16_t *ticks) __critical {
+    uint8_t high;
+    uint8_t low;
+
+    // Re-read if the low byte carried into the high byte between reads
+    do {
+        high = TH0;
+        low = TL0;
+    } while (high != TH0);
+
+    uint16_t count = ((uint16_t)high << 8) | low;
+    if (count >= 0xFD01) {
+        // Timer counts up from the reload value once per tick
+        *ms = time_overflows;
+        *ticks = count - 0xFD01;
+    } else {
+        // Timer wrapped, but the interrupt has not run yet to count the
+        // overflow and reload the timer, so it is counting up from 0
+        *ms = time_overflows + 1;
+        *ticks = count;
+    }
+}
+
+uint32_t time_get_ticks(void) {
+    uint32_t ms;
+    uint16_t ticks;
+    time_read(&ms, &ticks);
+    return ms * TIME_TICKS_PER_MS + ticks;
+}
+
+uint32_t time_get_us(void) {
+    uint32_t ms;
+    uint16_t ticks;
+    time_read(&ms, &ticks);
+    return ms * 1000 + ((uint32_t)ticks * 1000) / TIME_TICKS_PER_MS;
+}
+
+uint32_t time_elapsed_ticks(uint32_t start) {
+    return time_get_ticks() - start;
+}
+
+uint32_t time_ticks_to_us(uint32_t ticks) {
+    // Split to avoid overflowing on long intervals
+    return (ticks / TIME_TICKS_PER_MS) * 1000 +
+           ((ticks % TIME_TICKS_PER_MS) * 1000) / TIME_TICKS_PER_MS;
+}
@@ -583,6 +583,48 @@ int parallel_main(void) {
             // We must be in host mode
             parallel_state(port, PARALLEL_STATE_HOST);
 
+            // Read debug ring header: signature, size, and tail
+            res = parallel_ecms_read(port, 0xF00, data, 4);
+            if (res < 0)
+                goto err;
+
+            if (data[0] == 0x76 && data[1] == 0xEC) {
+                uint16_t size = (uint16_t)data[2];
+                uint16_t head = (uint16_t)data[3];
+                if (size == 0 || head >= size) {
+                    // Invalid header, reading the ring would never end
+                    res = -1;
+                    goto err;
+                }
+                for (;;) {
+                    // Read offset of the next byte to write
+                    res = parallel_ecms_read(port, 0xF03, data, 1);
+                    if (res < 0)
+                        goto err;
+
+                    uint16_t tail = (uint16_t)data[0];
+                    if (tail >= size) {
+                        // Torn or invalid read, try again
+                        continue;
+                    }
+                    while (head != tail) {
+                        // Read byte at head
+                        res = parallel_ecms_read(port, 0xF10 + head, data, 1);
+                        if (res < 0)
+                            goto err;
+
+                        // Print read byte
+                        serial_write(data, 1);
+
+                        head += 1;
+                        if (head >= size) {
+                            head = 0;
+                        }
+                    }
+                }
+            }
+
+            // Older firmware only has a tail at the start of the ring
             uint16_t head = 0;
             for (;;) {
                 // Read current position
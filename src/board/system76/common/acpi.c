@@ -26,171 +26,219 @@ enum EcOs acpi_ecos = EC_OS_NONE;
 
 extern bool pmc_s0_hack;
 
-void acpi_reset(void) {
-    // Disable lid wake
-    lid_wake = false;
+// Shadow of the ACPI space. Producers update it when their values change,
+// so reads are a single load, and multi-byte fields are always consistent.
+// It is also mapped read-only to the host at 0xD00 by H2RAM window 2, outside
+// of the zeroed data segment, so it is cleared by acpi_reset.
+static volatile uint8_t __xdata __at(0xD00) acpi_space[256];
+
+static void acpi_set_8(uint8_t addr, uint8_t value) {
+    acpi_space[addr] = value;
+}
 
-    // ECOS: No ACPI or driver
-    acpi_ecos = EC_OS_NONE;
+static void acpi_set_16(uint8_t addr, uint16_t value) {
+    acpi_space[addr] = (uint8_t)value;
+    acpi_space[addr + 1] = (uint8_t)(value >> 8);
+}
 
-#if HAVE_LED_AIRPLANE_N
-    // Clear airplane mode LED
-    gpio_set(&LED_AIRPLANE_N, true);
-#endif
+static void acpi_set_32(uint8_t addr, uint32_t value) {
+    acpi_set_16(addr, (uint16_t)value);
+    acpi_set_16(addr + 2, (uint16_t)(value >> 16));
 }
 
-// clang-format off
-uint8_t acpi_read(uint8_t addr) {
+void acpi_update_lid(void) {
+    // Lid state and other flags
     uint8_t data = 0;
+    if (gpio_get(&LID_SW_N)) {
+        // Lid is open
+        data |= BIT(0);
+    }
+    if (lid_wake) {
+        data |= BIT(2);
+    }
+    acpi_set_8(0x03, data);
+}
 
-    #define ACPI_8(K, V) \
-    case (K): \
-        data = (uint8_t)(V); \
-        break
-
-    #define ACPI_16(K, V) \
-        ACPI_8(K, V); \
-        ACPI_8((K) + 1, (V) >> 8)
-
-    #define ACPI_32(K, V) \
-        ACPI_16(K, V); \
-        ACPI_16((K) + 2, (V) >> 16)
-
-    switch (addr) {
-        // Lid state and other flags
-        case 0x03:
-            if (gpio_get(&LID_SW_N)) {
-                // Lid is open
-                data |= BIT(0);
-            }
-            if (lid_wake) {
-                data |= BIT(2);
-            }
-            break;
+static void acpi_update_adapter(void) {
+    // Handle AC adapter and battery present
+    uint8_t data = 0;
+    if (!gpio_get(&ACIN_N)) {
+        // AC adapter connected
+        data |= BIT(0);
+    }
+    if (battery_info.status & BATTERY_INITIALIZED) {
+        // BAT0 connected
+        data |= BIT(2);
+    }
+    acpi_set_8(0x10, data);
+}
 
-        ACPI_8(0x07, peci_temp);
-
-        // Handle AC adapter and battery present
-        case 0x10:
-            if (!gpio_get(&ACIN_N)) {
-                // AC adapter connected
-                data |= BIT(0);
-            }
-            if (battery_info.status & BATTERY_INITIALIZED) {
-                // BAT0 connected
-                data |= BIT(2);
-            }
-            break;
+void acpi_update_power(void) {
+    acpi_update_adapter();
 
-        ACPI_16(0x16, battery_info.design_capacity);
-        ACPI_16(0x1A, battery_info.full_capacity);
-        ACPI_16(0x22, battery_info.design_voltage);
-
-        case 0x26:
-            // If battery is not fully charged
-            if ((int16_t)battery_info.current > 0) {
-                // Battery is charging
-                data |= BIT(1);
-            } else if ((int16_t)battery_info.current < 0) {
-                // Battery isn't charging
-                data |= BIT(0);
-            }
-            break;
+#if HAVE_DGPU
+    acpi_set_8(0xD4, dgpu_get_d_notify_level(!gpio_get(&ACIN_N)));
+#endif // HAVE_DGPU
 
-        ACPI_16(0x2A, battery_info.current);
-        ACPI_16(0x2E, battery_info.remaining_capacity);
-        ACPI_16(0x32, battery_info.voltage);
+    acpi_set_32(0xD5, (uint32_t)battery_charger_input_current_ma *
+                      (uint32_t)battery_charger_input_voltage_v);
 
-        ACPI_16(0x42, battery_info.cycle_count);
+#if HAVE_LED_AIRPLANE_N
+    // Airplane mode LED
+    acpi_set_8(0xD9, gpio_get(&LED_AIRPLANE_N) ? 0 : BIT(6));
+#endif // HAVE_LED_AIRPLANE_N
 
-        case 0x68:
-            data = acpi_ecos;
-            // HACK: Kick PMC to fix suspend on lemp11
-            pmc_s0_hack = true;
-            break;
+    // Power engine plug-in hook for S0ix
+    acpi_set_8(0xE0, pep_hook);
+}
 
-        case 0xBC:
-            data = battery_get_start_threshold();
-            break;
+void acpi_update_battery(void) {
+    acpi_update_adapter();
 
-        case 0xBD:
-            data = battery_get_end_threshold();
-            break;
+    acpi_set_16(0x16, battery_info.design_capacity);
+    acpi_set_16(0x1A, battery_info.full_capacity);
+    acpi_set_16(0x22, battery_info.design_voltage);
+
+    uint8_t data = 0;
+    // If battery is not fully charged
+    if ((int16_t)battery_info.current > 0) {
+        // Battery is charging
+        data |= BIT(1);
+    } else if ((int16_t)battery_info.current < 0) {
+        // Battery isn't charging
+        data |= BIT(0);
+    }
+    acpi_set_8(0x26, data);
+
+    acpi_set_16(0x2A, battery_info.current);
+    acpi_set_16(0x2E, battery_info.remaining_capacity);
+    acpi_set_16(0x32, battery_info.voltage);
 
-        ACPI_8(0xCC, sci_extra);
+    acpi_set_16(0x42, battery_info.cycle_count);
 
-        ACPI_8(0xCE, PWM_REG(CPU_FAN1));
-        ACPI_8(0xD0, F1TLRR);
-        ACPI_8(0xD1, F1TMRR);
+    acpi_set_8(0xBC, battery_get_start_threshold());
+    acpi_set_8(0xBD, battery_get_end_threshold());
+}
+
+void acpi_update_fan(void) {
+    acpi_set_8(0x07, (uint8_t)peci_temp);
+
+    acpi_set_8(0xCE, PWM_REG(CPU_FAN1));
+    acpi_set_8(0xD0, F1TLRR);
+    acpi_set_8(0xD1, F1TMRR);
 #ifdef CPU_FAN2
-        ACPI_8(0xCF, PWM_REG(CPU_FAN2));
-        ACPI_8(0xD2, F2TLRR);
-        ACPI_8(0xD3, F2TMRR);
+    acpi_set_8(0xCF, PWM_REG(CPU_FAN2));
+    acpi_set_8(0xD2, F2TLRR);
+    acpi_set_8(0xD3, F2TMRR);
 #endif
 #if HAVE_DGPU
-        ACPI_8(0xCD, dgpu_temp);
-        ACPI_8(0xCF, PWM_REG(GPU_FAN1));
-        ACPI_8(0xD2, F2TLRR);
-        ACPI_8(0xD3, F2TMRR);
-
-        case 0xD4:
-            data = dgpu_get_d_notify_level(!gpio_get(&ACIN_N));
-            break;
+    acpi_set_8(0xCD, (uint8_t)dgpu_temp);
+    acpi_set_8(0xCF, PWM_REG(GPU_FAN1));
+    acpi_set_8(0xD2, F2TLRR);
+    acpi_set_8(0xD3, F2TMRR);
 #endif // HAVE_DGPU
+}
 
-        ACPI_32(0xD5, (uint32_t)battery_charger_input_current_ma *
-                      (uint32_t)battery_charger_input_voltage_v);
+void acpi_update_sci(void) {
+    acpi_set_8(0xCC, sci_extra);
+}
 
-#if HAVE_LED_AIRPLANE_N
-        // Airplane mode LED
-        case 0xD9:
-            if (!gpio_get(&LED_AIRPLANE_N)) {
-                data |= BIT(6);
-            }
-            break;
-#endif // HAVE_LED_AIRPLANE_N
+uint8_t acpi_read(uint8_t addr) {
+    uint8_t data = acpi_space[addr];
 
-        // Power engine plug-in hook for S0ix
-        case 0xE0:
-            data = pep_hook;
-            break;
+    if (addr == 0x68) {
+        // HACK: Kick PMC to fix suspend on lemp11
+        pmc_s0_hack = true;
     }
 
     TRACE("acpi_read %02X = %02X\n", addr, data);
     return data;
 }
-// clang-format on
 
-void acpi_write(uint8_t addr, uint8_t data) {
-    TRACE("acpi_write %02X = %02X\n", addr, data);
+static void acpi_write_lid(uint8_t data) {
+    lid_wake = (bool)(data & BIT(2));
+    acpi_update_lid();
+}
 
-    switch (addr) {
-    // Lid state and other flags
-    case 0x03:
-        lid_wake = (bool)(data & BIT(2));
-        break;
+static void acpi_write_ecos(uint8_t data) {
+    acpi_ecos = (enum EcOs)data;
+    acpi_set_8(0x68, acpi_ecos);
+}
 
-    case 0x68:
-        acpi_ecos = (enum EcOs)data;
-        break;
+static void acpi_write_start_threshold(uint8_t data) {
+    battery_set_start_threshold(data);
+    acpi_set_8(0xBC, battery_get_start_threshold());
+}
 
-    case 0xBC:
-        battery_set_start_threshold(data);
-        break;
+static void acpi_write_end_threshold(uint8_t data) {
+    battery_set_end_threshold(data);
+    acpi_set_8(0xBD, battery_get_end_threshold());
+}
 
-    case 0xBD:
-        battery_set_end_threshold(data);
-        break;
+#if HAVE_LED_AIRPLANE_N
+static void acpi_write_airplane(uint8_t data) {
+    gpio_set(&LED_AIRPLANE_N, !(bool)(data & BIT(6)));
+    acpi_update_power();
+}
+#endif // HAVE_LED_AIRPLANE_N
 
+static void acpi_write_pep_hook(uint8_t data) {
+    pep_hook = data;
+    acpi_set_8(0xE0, pep_hook);
+}
+
+struct AcpiWrite {
+    uint8_t addr;
+    void (*write)(uint8_t data);
+};
+
+// clang-format off
+static const struct AcpiWrite __code acpi_writes[] = {
+    // Lid state and other flags
+    { 0x03, acpi_write_lid },
+    { 0x68, acpi_write_ecos },
+    { 0xBC, acpi_write_start_threshold },
+    { 0xBD, acpi_write_end_threshold },
 #if HAVE_LED_AIRPLANE_N
     // Airplane mode LED
-    case 0xD9:
-        gpio_set(&LED_AIRPLANE_N, !(bool)(data & BIT(6)));
-        break;
+    { 0xD9, acpi_write_airplane },
 #endif
     // Power engine plug-in hook for S0ix
-    case 0xE0:
-        pep_hook = data;
-        break;
+    { 0xE0, acpi_write_pep_hook },
+};
+// clang-format on
+
+void acpi_write(uint8_t addr, uint8_t data) {
+    TRACE("acpi_write %02X = %02X\n", addr, data);
+
+    for (uint8_t i = 0; i < ARRAY_SIZE(acpi_writes); i++) {
+        if (acpi_writes[i].addr == addr) {
+            acpi_writes[i].write(data);
+            break;
+        }
     }
 }
+
+void acpi_reset(void) {
+    for (uint16_t i = 0; i < ARRAY_SIZE(acpi_space); i++) {
+        acpi_space[i] = 0;
+    }
+
+    // Disable lid wake
+    lid_wake = false;
+
+    // ECOS: No ACPI or driver
+    acpi_ecos = EC_OS_NONE;
+
+#if HAVE_LED_AIRPLANE_N
+    // Clear airplane mode LED
+    gpio_set(&LED_AIRPLANE_N, true);
+#endif
+
+    acpi_set_8(0x68, acpi_ecos);
+    acpi_update_lid();
+    acpi_update_power();
+    acpi_update_battery();
+    acpi_update_fan();
+    acpi_update_sci();
+}
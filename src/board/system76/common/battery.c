@@ -1,8 +1,10 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <board/acpi.h>
 #include <board/battery.h>
 #include <board/options.h>
 #include <board/smbus.h>
+#include <board/telemetry.h>
 #include <common/debug.h>
 
 struct battery_info battery_info = { 0 };
@@ -88,4 +90,7 @@ void battery_event(void) {
     TRACE("BAT %d mV %d mA\n", battery_info.voltage, battery_info.current);
 
     battery_charger_event();
+
+    acpi_update_battery();
+    telemetry_update();
 }
@@ -8,7 +8,10 @@ board-common-y += ecpm.c
 board-common-$(CONFIG_BUS_ESPI) += espi.c
 board-common-y += fan.c
 board-common-y += gctrl.c
+board-common-y += host_input.c
+board-common-y += idle.c
 board-common-y += kbc.c
+board-common-y += kbghost.c
 board-common-y += kbled.c
 board-common-y += kbscan.c
 board-common-y += keymap.c
@@ -27,6 +30,9 @@ board-common-$(CONFIG_SECURITY) += security.c
 board-common-y += smbus.c
 board-common-y += smfi.c
 board-common-y += stdio.c
+board-common-y += task.c
+board-common-y += task_select.c
+board-common-y += telemetry.c
 board-common-y += wireless.c
 
 # Set log level
@@ -38,12 +44,27 @@ board-common-y += wireless.c
 # 5 - TRACE
 CFLAGS+=-DLEVEL=2
 
+# Uncomment to send log messages as tokens, decoded by the console of
+# dasharo_ectool with build/<board>/<version>/log_tokens.txt
+#CONFIG_LOG_TOKENS=y
+
+# Uncomment to shrink the debug ring mapped to the host (32, 64, 128, or 256)
+#CFLAGS+=-DSMFI_DBG_SIZE=128
+
+# Uncomment to change the size of the KBC scancode buffer (a power of two, up
+# to 128). CI links a board with the largest size.
+#KBC_BUFFER_SIZE=128
+
 # Uncomment to enable debug logging over keyboard parallel port
 #CFLAGS+=-DPARALLEL_DEBUG
 
 # Uncomment to enable I2C debug on 0x76
 #CFLAGS+=-DI2C_DEBUGGER=0x76
 
+ifneq ($(KBC_BUFFER_SIZE),)
+CFLAGS+=-DKBC_BUFFER_SIZE=$(KBC_BUFFER_SIZE)
+endif
+
 ifeq ($(CONFIG_SECURITY),y)
 CFLAGS+=-DCONFIG_SECURITY=1
 endif
@@ -60,6 +81,13 @@ CFLAGS += -DCONFIG_PECI_OVER_ESPI=1
 endif
 endif
 
+ifeq ($(CONFIG_LOG_TOKENS),y)
+CFLAGS+=-DCONFIG_LOG_TOKENS=1
+# Identify the file of each log call, as named by scripts/log_tokens.py
+CFLAGS+=-DLOG_FILE=$(subst -,_,$(subst .,_,$(subst /,_,$<)))
+board-common-y += log.c
+endif
+
 # Include system76 common source
 SYSTEM76_COMMON_DIR=src/board/system76/common
 INCLUDE += $(SYSTEM76_COMMON_DIR)/common.mk
@@ -80,6 +108,17 @@ endif
 KEYBOARD_DIR=src/keyboard/system76/$(KEYBOARD)
 include $(KEYBOARD_DIR)/keyboard.mk
 
+# Add mask of keys in the keymap
+include $(SYSTEM76_COMMON_DIR)/keymask/keymask.mk
+
+# Add log tokens
+ifeq ($(CONFIG_LOG_TOKENS),y)
+include $(SYSTEM76_COMMON_DIR)/log.mk
+endif
+
+# Add host tests
+include $(SYSTEM76_COMMON_DIR)/test/test.mk
+
 # Add kbled
 KBLED?=none
 board-common-y += kbled/$(KBLED).c
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <board/host_input.h>
+#include <ec/kbc.h>
+#include <ec/pmc.h>
+
+// KBC and PMC share the layout of the status register
+_Static_assert(KBC_STS_IBF == PMC_STS_IBF, "KBC and PMC IBF bits differ");
+
+// Registers are accessed directly, as this runs in the interrupt handler
+void host_input_fill(
+    volatile struct HostInput *input,
+    volatile uint8_t *status,
+    volatile uint8_t *data_in
+) {
+    while ((uint8_t)(input->tail - input->head) < HOST_INPUT_SIZE) {
+        uint8_t sts = *status;
+        if (!(sts & KBC_STS_IBF)) {
+            break;
+        }
+        uint8_t i = input->tail & HOST_INPUT_MASK;
+        input->sts[i] = sts;
+        input->data[i] = *data_in;
+        input->tail++;
+    }
+}
+
+bool host_input_empty(volatile struct HostInput *input) {
+    return input->head == input->tail;
+}
+
+bool host_input_pop(
+    volatile struct HostInput *input,
+    volatile uint8_t *status,
+    volatile uint8_t *data_in,
+    uint8_t *sts,
+    uint8_t *data
+) __critical {
+    // Pick up input left by the interrupt when the FIFO was full
+    host_input_fill(input, status, data_in);
+    if (host_input_empty(input)) {
+        return false;
+    }
+    uint8_t i = input->head & HOST_INPUT_MASK;
+    *sts = input->sts[i];
+    *data = input->data[i];
+    input->head++;
+    return true;
+}
@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Puts the 8051 core in idle mode when the main loop has nothing to do. The
+// core is woken by the next interrupt: timer 0 once per millisecond, or the
+// INTC for host and keyboard activity. Host writes to the KBC and PMC are
+// also read by the INTC interrupt, and queued for the main loop.
+
+#include <8051.h>
+#include <stdbool.h>
+
+#include <arch/time.h>
+#include <board/idle.h>
+#include <board/kbc.h>
+#include <board/pmc.h>
+#include <common/macro.h>
+#include <ec/intc.h>
+
+uint8_t idle_active = 100;
+
+// Set by interrupts that may have made a task due
+static volatile bool idle_wake = false;
+// Timer 0 ticks spent idle in the current interval
+static uint32_t idle_ticks = 0;
+// Start of the current interval
+static uint32_t idle_start = 0;
+
+#define IDLE_INTERVAL 1000
+
+void external_1(void) __interrupt(2) {
+    uint8_t irq;
+    while ((irq = intc_get_irq()) != INTC_IRQ_NONE) {
+        intc_clear(irq);
+        switch (irq) {
+        case INTC_IRQ_KBC_IBF:
+            kbc_interrupt();
+            break;
+        case INTC_IRQ_PMC_IBF:
+        case INTC_IRQ_PMC2_IBF:
+            pmc_interrupt();
+            break;
+        }
+    }
+    idle_wake = true;
+}
+
+void idle_init(void) {
+    // Wake on host writes to KBC and PMC
+    intc_enable(INTC_IRQ_KBC_IBF);
+    intc_enable(INTC_IRQ_PMC_IBF);
+    intc_enable(INTC_IRQ_PMC2_IBF);
+    // Wake on PS/2 transactions
+    intc_enable(INTC_IRQ_PS2_1);
+    intc_enable(INTC_IRQ_PS2_2);
+    intc_enable(INTC_IRQ_PS2_3);
+
+    // Enable INTC interrupt to 8051
+    EX1 = 1;
+
+    idle_start = time_get();
+}
+
+void idle_wait(void) {
+    // An interrupt between testing idle_wake and entering idle mode would not
+    // wake the core, so interrupts are held off until then. The 8051 always
+    // executes the instruction after one writing IE before servicing an
+    // interrupt, so a pending interrupt wakes the core from idle mode.
+    EA = 0;
+    if (!idle_wake) {
+        uint32_t start = time_get_ticks();
+        // Idle until next interrupt
+        EA = 1;
+        PCON |= IDL;
+        idle_ticks += time_elapsed_ticks(start);
+    } else {
+        EA = 1;
+    }
+    idle_wake = false;
+}
+
+void idle_event(void) {
+    uint32_t time = time_get();
+    uint32_t elapsed = time - idle_start;
+    if (elapsed >= IDLE_INTERVAL) {
+        uint32_t idle = idle_ticks / TIME_TICKS_PER_MS;
+        if (idle > elapsed) {
+            idle = elapsed;
+        }
+        idle_active = (uint8_t)(100 - (idle * 100) / elapsed);
+
+        idle_ticks = 0;
+        idle_start = time;
+    }
+}
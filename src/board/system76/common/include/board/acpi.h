@@ -16,6 +16,12 @@ enum EcOs {
 extern enum EcOs acpi_ecos;
 
 void acpi_reset(void);
+// Update the ACPI space from the values of each producer
+void acpi_update_lid(void);
+void acpi_update_power(void);
+void acpi_update_battery(void);
+void acpi_update_fan(void);
+void acpi_update_sci(void);
 uint8_t acpi_read(uint8_t addr);
 void acpi_write(uint8_t addr, uint8_t data);
 
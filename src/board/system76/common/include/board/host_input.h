@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef _BOARD_HOST_INPUT_H
+#define _BOARD_HOST_INPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Host input is read by the IBF interrupt as soon as it arrives, so the host
+// can continue without waiting for the main loop. Status and data are kept
+// in pairs. Must be a power of two.
+#define HOST_INPUT_SIZE 4
+#define HOST_INPUT_MASK (HOST_INPUT_SIZE - 1)
+
+// FIFO of host input of a KBC or PMC
+struct HostInput {
+    uint8_t sts[HOST_INPUT_SIZE];
+    uint8_t data[HOST_INPUT_SIZE];
+    // Free running indexes, masked on access
+    uint8_t head;
+    uint8_t tail;
+};
+
+// Move host input from the status and data in registers to the FIFO. Must be
+// called with interrupts disabled.
+void host_input_fill(
+    volatile struct HostInput *input,
+    volatile uint8_t *status,
+    volatile uint8_t *data_in
+);
+// Returns true if the FIFO has no input
+bool host_input_empty(volatile struct HostInput *input);
+// Take the oldest input from the FIFO, returning false if there is none
+bool host_input_pop(
+    volatile struct HostInput *input,
+    volatile uint8_t *status,
+    volatile uint8_t *data_in,
+    uint8_t *sts,
+    uint8_t *data
+);
+
+#endif // _BOARD_HOST_INPUT_H
@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef _BOARD_IDLE_H
+#define _BOARD_IDLE_H
+
+#include <stdint.h>
+
+// Percentage of time the EC was not idle over the last second
+extern uint8_t idle_active;
+
+void idle_init(void);
+// Idle until the next interrupt, unless one arrived since the last call
+void idle_wait(void);
+// Update the active time percentage
+void idle_event(void);
+
+#endif // _BOARD_IDLE_H
@@ -9,9 +9,42 @@
 
 extern uint8_t kbc_leds;
 
+// Number of latency histogram buckets
+#define KBC_LATENCY_BUCKETS 12
+// Upper bound of the first latency histogram bucket, in us
+#define KBC_LATENCY_BASE 128
+
+// Time from detecting a key transition to writing its last scancode byte to
+// the host
+struct KbcLatency {
+    // Bucket n counts latencies below KBC_LATENCY_BASE << n us, the last
+    // bucket counts all others. Counts saturate.
+    uint16_t histogram[KBC_LATENCY_BUCKETS];
+    // Longest latency, in us
+    uint32_t max;
+};
+
+extern struct KbcLatency kbc_latency;
+// Scancode sequences that did not fit in the buffer, saturating
+extern uint16_t kbc_buffer_overflow;
+
+// Key transition of a scancode sequence
+struct KbcKey {
+    uint16_t key;
+    bool pressed;
+};
+
 void kbc_init(void);
+// Queue the scancodes of a key transition, returns false if the buffer is full
 bool kbc_scancode(uint16_t key, bool pressed);
+// Queue the scancodes of a sequence of key transitions, all of them or none if
+// they do not fit in the buffer
+bool kbc_scancodes(const struct KbcKey __code *keys, uint8_t count);
+bool kbc_pending(struct Kbc *kbc);
 void kbc_event(struct Kbc *kbc);
 void kbc_clear_lock(void);
+// Read host input, called by the KBC IBF interrupt
+void kbc_interrupt(void);
+void kbc_latency_reset(void);
 
 #endif // _BOARD_KBC_H
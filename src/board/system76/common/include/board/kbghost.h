@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef _BOARD_KBGHOST_H
+#define _BOARD_KBGHOST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Returns true if the keys pressed in a row of the matrix may include ghosts,
+// that is if two of its columns are also pressed in another row. Only keys
+// set in real_keys are considered, so blanks of the matrix are ignored.
+bool kbghost_in_row(
+    const uint8_t __xdata *matrix,
+    const uint8_t __code *real_keys,
+    uint8_t count,
+    uint8_t row
+);
+
+#endif // _BOARD_KBGHOST_H
@@ -24,7 +24,26 @@ extern uint16_t kbscan_repeat_delay;
 // Debounced kbscan matrix
 extern uint8_t kbscan_matrix[KM_OUT];
 
+// Time the current scan started, in ticks
+extern uint32_t kbscan_time;
+
+// Ticks to wait after selecting each output
+extern uint8_t kbscan_settle[KM_OUT];
+// Ticks to wait after driving all outputs at the end of a scan
+extern uint8_t kbscan_release;
+
+// Settle time calibration is running
+extern bool kbscan_calibrating;
+// Shortest reliable settle time measured for each output, in ticks, or 0xFF
+// if the output was not measured
+extern uint8_t kbscan_calibration[KM_OUT];
+
 void kbscan_init(void);
+// Start measuring settle times, keys must be held to take measurements
+void kbscan_calibrate_start(void);
+// Stop measuring settle times, and scan with them if apply is set
+void kbscan_calibrate_stop(bool apply);
+bool kbscan_pending(void);
 void kbscan_event(void);
 
 #endif // _BOARD_KBSCAN_H
@@ -5,9 +5,28 @@
 
 #include <ec/pmc.h>
 
+// ACPI traffic counters, wrapping
+struct PmcStats {
+    // ACPI read commands completed
+    uint32_t reads;
+    // ACPI write commands completed
+    uint32_t writes;
+    // SCI event queries
+    uint32_t queries;
+    // SCI pulses requested
+    uint32_t sci;
+    // SWI pulses requested
+    uint32_t swi;
+};
+
+extern struct PmcStats pmc_stats;
+
 void pmc_init(void);
 bool pmc_sci(struct Pmc *pmc, uint8_t sci);
 void pmc_swi(void);
+bool pmc_pending(struct Pmc *pmc);
 void pmc_event(struct Pmc *pmc);
+// Read host input, called by the PMC and PMC2 IBF interrupts
+void pmc_interrupt(void);
 
 #endif // _BOARD_PMC_H
@@ -3,10 +3,12 @@
 #ifndef _BOARD_SMFI_H
 #define _BOARD_SMFI_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 void smfi_init(void);
 void smfi_watchdog(void);
+bool smfi_pending(void);
 void smfi_event(void);
 void smfi_debug(uint8_t byte);
 
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef _BOARD_TASK_H
+#define _BOARD_TASK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Tasks run by the main loop, in table order
+enum TaskId {
+    TASK_KBSCAN = 0,
+    TASK_KBC,
+    TASK_PMC,
+    TASK_PMC2,
+    TASK_SMFI,
+    TASK_POWER,
+    TASK_LID,
+    TASK_BOARD,
+    TASK_FAN,
+    TASK_BATTERY,
+    TASK_COUNT
+};
+
+struct Task {
+    // Short name reported by the profiler
+    const char *name;
+    // Function to call when the task is run
+    void (*run)(void);
+    // Function returning true if the task has work to do, or NULL if the task
+    // always runs once its period has elapsed
+    bool (*pending)(void);
+    // Minimum time between runs, in ms
+    uint16_t period;
+    // Maximum time the task may wait after becoming due, in ms
+    uint16_t deadline;
+};
+
+// Execution time of a task, in timer 0 ticks
+struct TaskProfile {
+    uint32_t last;
+    uint32_t min;
+    uint32_t max;
+    // Moving average over roughly the last 8 runs
+    uint32_t avg;
+    // Number of runs, saturating
+    uint16_t runs;
+};
+
+extern struct TaskProfile task_profile[TASK_COUNT];
+
+// Get the name of a task
+const char *task_name(enum TaskId id);
+// Select the due task with the least slack before its deadline, starting after
+// current so that ties take turns. Returns count if no task is due.
+uint8_t task_select(
+    const struct Task *tasks,
+    const uint32_t *last,
+    uint8_t count,
+    uint16_t triggered,
+    uint8_t current,
+    uint32_t time
+);
+// Run the most urgent due task, returns false if no task was due
+bool task_run(void);
+// Make a task due immediately
+void task_trigger(enum TaskId id);
+
+#endif // _BOARD_TASK_H
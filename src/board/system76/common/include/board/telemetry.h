@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef _BOARD_TELEMETRY_H
+#define _BOARD_TELEMETRY_H
+
+#include <stdint.h>
+
+#include <common/macro.h>
+
+// Incremented when the layout of struct Telemetry changes
+#define TELEMETRY_VERSION 1
+// Size of the page mapped to the host, struct Telemetry must fit in it
+#define TELEMETRY_SIZE 32
+
+#define TELEMETRY_FLAG_AC BIT(0)
+#define TELEMETRY_FLAG_LID BIT(1)
+
+// Snapshot of EC state, mapped read-only to the host at 0xC00. Multi-byte
+// fields are little-endian.
+//
+// The host reads sequence, then the fields, then sequence again. The read is
+// consistent if both sequence values are equal and even.
+struct Telemetry {
+    uint8_t version;
+    // Incremented before and after each update, so it is odd while updating
+    uint8_t sequence;
+    // Time of the last update, in ms
+    uint32_t time;
+    // See enum PowerState
+    uint8_t power_state;
+    // TELEMETRY_FLAG_*
+    uint8_t flags;
+    // Temperatures, in degrees C
+    int16_t cpu_temp;
+    int16_t dgpu_temp;
+    // Fan duty cycles, 0 to 255, and tachometer readings
+    uint8_t fan_duty[2];
+    uint16_t fan_tach[2];
+    // Charger input current limit, in mA
+    uint16_t charger_input_current;
+    // Battery, in mV, mA, percent, and mAh
+    uint16_t battery_voltage;
+    int16_t battery_current;
+    uint16_t battery_charge;
+    uint16_t battery_remaining_capacity;
+    uint16_t battery_full_capacity;
+    uint16_t battery_status;
+};
+
+void telemetry_init(void);
+// Copy the current state into the telemetry page
+void telemetry_update(void);
+
+#endif // _BOARD_TELEMETRY_H
@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <arch/delay.h>
+#include <arch/time.h>
+#include <board/host_input.h>
 #include <board/kbc.h>
 #include <board/kbscan.h>
 #include <board/keymap.h>
@@ -10,8 +12,8 @@
 #include <ec/ps2.h>
 
 void kbc_init(void) {
-    // Disable interrupts
-    *(KBC.control) = 0;
+    // Disable host interrupts, enable IBF interrupt to wake EC
+    *(KBC.control) = BIT(3);
 #if CONFIG_BUS_ESPI
     // Set IRQ mode to edge-triggered, 1-cycle pulse width
     *(KBC.irq) = BIT(3);
@@ -80,44 +82,123 @@ static const uint16_t kbc_typematic_period[32] = {
 };
 // clang-format on
 
-static uint8_t kbc_buffer[16] = { 0 };
+// Size of the scancode buffer, must be a power of two no larger than 128
+#ifndef KBC_BUFFER_SIZE
+#define KBC_BUFFER_SIZE 32
+#endif // KBC_BUFFER_SIZE
+
+#if (KBC_BUFFER_SIZE & (KBC_BUFFER_SIZE - 1)) || KBC_BUFFER_SIZE > 128
+#error "KBC_BUFFER_SIZE must be a power of two no larger than 128"
+#endif
+
+#define KBC_BUFFER_MASK (KBC_BUFFER_SIZE - 1)
+
+static uint8_t kbc_buffer[KBC_BUFFER_SIZE] = { 0 };
+// Free running indexes, masked on access
 static uint8_t kbc_buffer_head = 0;
 static uint8_t kbc_buffer_tail = 0;
+// Scancode is the last byte of a timed key transition, one bit per scancode
+static uint8_t kbc_buffer_end[(KBC_BUFFER_SIZE + 7) / 8] = { 0 };
+
+// Transitions take at least one scancode and usually two, so only half as
+// many are timed. Transitions pushed while all are in use are not timed.
+#define KBC_TIMES_SIZE ((KBC_BUFFER_SIZE + 1) / 2)
+#define KBC_TIMES_MASK (KBC_TIMES_SIZE - 1)
+
+// Time each timed key transition in the buffer was detected, in ticks
+static uint32_t kbc_times[KBC_TIMES_SIZE] = { 0 };
+// Free running indexes, masked on access
+static uint8_t kbc_times_head = 0;
+static uint8_t kbc_times_tail = 0;
+
+uint16_t kbc_buffer_overflow = 0;
+
+struct KbcLatency kbc_latency = { 0 };
+// Detection time of the transition completed by the pending output byte
+static uint32_t kbc_latency_start = 0;
+// Pending output byte completes a key transition
+static bool kbc_latency_pending = false;
+
+static void kbc_latency_record(uint32_t ticks) {
+    uint32_t us = time_ticks_to_us(ticks);
+    if (us > kbc_latency.max) {
+        kbc_latency.max = us;
+    }
+
+    uint8_t bucket = 0;
+    us /= KBC_LATENCY_BASE;
+    while (us && bucket < (KBC_LATENCY_BUCKETS - 1)) {
+        us >>= 1;
+        bucket++;
+    }
+    if (kbc_latency.histogram[bucket] < 0xFFFF) {
+        kbc_latency.histogram[bucket]++;
+    }
+}
+
+void kbc_latency_reset(void) {
+    for (uint8_t i = 0; i < KBC_LATENCY_BUCKETS; i++) {
+        kbc_latency.histogram[i] = 0;
+    }
+    kbc_latency.max = 0;
+}
+
+static inline uint8_t kbc_buffer_count(void) {
+    return (uint8_t)(kbc_buffer_tail - kbc_buffer_head);
+}
 
 static bool kbc_buffer_pop(uint8_t *scancode) {
-    if (kbc_buffer_head == kbc_buffer_tail) {
+    if (kbc_buffer_count() == 0) {
         return false;
     }
-    *scancode = kbc_buffer[kbc_buffer_head];
-    kbc_buffer_head = (kbc_buffer_head + 1U) % ARRAY_SIZE(kbc_buffer);
+    uint8_t i = kbc_buffer_head & KBC_BUFFER_MASK;
+    *scancode = kbc_buffer[i];
+    kbc_latency_pending = kbc_buffer_end[i >> 3] & BIT(i & 7);
+    if (kbc_latency_pending) {
+        kbc_latency_start = kbc_times[kbc_times_head & KBC_TIMES_MASK];
+        kbc_times_head++;
+    }
+    kbc_buffer_head++;
     return true;
 }
 
-static bool kbc_buffer_push(uint8_t *scancodes, uint8_t len) {
-    //TODO: make this test more efficient
-    for (uint8_t i = 0; i < len; i++) {
-        if ((kbc_buffer_tail + i + 1U) % ARRAY_SIZE(kbc_buffer) == kbc_buffer_head) {
-            return false;
+static bool kbc_buffer_push(uint8_t *scancodes, uint8_t len, uint32_t time) {
+    if ((KBC_BUFFER_SIZE - kbc_buffer_count()) < len) {
+        if (kbc_buffer_overflow < 0xFFFF) {
+            kbc_buffer_overflow++;
         }
+        return false;
+    }
+
+    bool timed = len && (uint8_t)(kbc_times_tail - kbc_times_head) < KBC_TIMES_SIZE;
+    if (timed) {
+        kbc_times[kbc_times_tail & KBC_TIMES_MASK] = time;
+        kbc_times_tail++;
     }
 
     for (uint8_t i = 0; i < len; i++) {
-        kbc_buffer[kbc_buffer_tail] = scancodes[i];
-        kbc_buffer_tail = (kbc_buffer_tail + 1U) % ARRAY_SIZE(kbc_buffer);
+        uint8_t j = kbc_buffer_tail & KBC_BUFFER_MASK;
+        kbc_buffer[j] = scancodes[i];
+        if (timed && (i + 1) == len) {
+            kbc_buffer_end[j >> 3] |= BIT(j & 7);
+        } else {
+            kbc_buffer_end[j >> 3] &= ~BIT(j & 7);
+        }
+        kbc_buffer_tail++;
     }
     return true;
 }
 
-bool kbc_scancode(uint16_t key, bool pressed) {
+// Scancodes of a key transition, returns their count
+static uint8_t kbc_scancode_bytes(uint16_t key, bool pressed, uint8_t *scancodes) {
     if (!kbc_first)
-        return true;
+        return 0;
     if (kbc_translate) {
         key = keymap_translate(key);
     }
     if (!key)
-        return true;
+        return 0;
 
-    uint8_t scancodes[3] = { 0, 0, 0 };
     uint8_t scancodes_len = 0;
     switch (key & 0xFF00) {
     case KF_E0:
@@ -135,8 +216,33 @@ bool kbc_scancode(uint16_t key, bool pressed) {
         scancodes[scancodes_len++] = (uint8_t)key;
         break;
     }
+    return scancodes_len;
+}
+
+bool kbc_scancode(uint16_t key, bool pressed) {
+    uint8_t scancodes[3] = { 0, 0, 0 };
+    uint8_t scancodes_len = kbc_scancode_bytes(key, pressed, scancodes);
+    return kbc_buffer_push(scancodes, scancodes_len, kbscan_time);
+}
+
+bool kbc_scancodes(const struct KbcKey __code *keys, uint8_t count) {
+    uint8_t scancodes[3];
+    uint16_t len = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        len += kbc_scancode_bytes(keys[i].key, keys[i].pressed, scancodes);
+    }
+    if ((KBC_BUFFER_SIZE - kbc_buffer_count()) < len) {
+        if (kbc_buffer_overflow < 0xFFFF) {
+            kbc_buffer_overflow++;
+        }
+        return false;
+    }
 
-    return kbc_buffer_push(scancodes, scancodes_len);
+    // Every transition fits, so none of them fail
+    for (uint8_t i = 0; i < count; i++) {
+        kbc_scancode(keys[i].key, keys[i].pressed);
+    }
+    return true;
 }
 
 enum KbcState {
@@ -160,6 +266,12 @@ enum KbcState {
     KBC_STATE_SELF_TEST,
 };
 
+static volatile struct HostInput kbc_input = { 0 };
+
+void kbc_interrupt(void) {
+    host_input_fill(&kbc_input, &KBHISR, &KBHIDIR);
+}
+
 // TODO: state per KBC (we only have one KBC so low priority)
 static enum KbcState state = KBC_STATE_NORMAL;
 static uint8_t state_data = 0;
@@ -174,6 +286,8 @@ static void kbc_clear_output(struct Kbc *kbc) {
 
 static void kbc_on_input_command(struct Kbc *kbc, uint8_t data) {
     TRACE("kbc cmd: %02X\n", data);
+    // A pending scancode is replaced by the response
+    kbc_latency_pending = false;
     // Controller commands always reset the state
     state = KBC_STATE_NORMAL;
     // Controller commands clear the output buffer
@@ -421,6 +535,10 @@ static void kbc_on_output_empty(struct Kbc *kbc) {
     case KBC_STATE_KEYBOARD:
         TRACE("kbc keyboard: %02X\n", state_data);
         if (kbc_keyboard(kbc, state_data, KBC_TIMEOUT)) {
+            if (kbc_latency_pending) {
+                kbc_latency_record(time_elapsed_ticks(kbc_latency_start));
+                kbc_latency_pending = false;
+            }
             state = state_next;
             state_next = KBC_STATE_NORMAL;
         }
@@ -455,6 +573,66 @@ static void kbc_on_output_empty(struct Kbc *kbc) {
     }
 }
 
+bool kbc_pending(struct Kbc *kbc) {
+    uint8_t sts = kbc_status(kbc);
+    // Command or data from host
+    if (!host_input_empty(&kbc_input) || (sts & KBC_STS_IBF)) {
+        return true;
+    }
+    // Data for host, once it has read the last byte
+    if (!(sts & KBC_STS_OBF)) {
+        if (state >= KBC_STATE_KEYBOARD || kbc_buffer_count() != 0) {
+            return true;
+        }
+    }
+    // Touchpad transaction in progress or finished
+    if (kbc_second) {
+        if (kbc_second_wait > 0) {
+            return true;
+        }
+        if (*(PS2_TOUCHPAD.status) & (PSSTS_DONE | PSSTS_ALL_ERR)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Time to wait for the host to read each byte of a burst, in us
+#define KBC_BURST_TIMEOUT 100
+// Maximum bytes written by one burst
+#define KBC_BURST_MAX 8
+
+// Write buffered scancodes as soon as the host reads each one, instead of
+// once per main loop iteration
+static void kbc_burst(struct Kbc *kbc) {
+    for (uint8_t i = 0; i < KBC_BURST_MAX; i++) {
+        if (state != KBC_STATE_NORMAL || kbc_buffer_count() == 0) {
+            return;
+        }
+
+        uint16_t timeout = KBC_BURST_TIMEOUT;
+        for (;;) {
+            uint8_t sts = kbc_status(kbc);
+            // Handle host commands first
+            if (!host_input_empty(&kbc_input) || (sts & KBC_STS_IBF)) {
+                return;
+            }
+            if (!(sts & KBC_STS_OBF)) {
+                break;
+            }
+            if (timeout == 0) {
+                return;
+            }
+            timeout -= 1;
+            delay_us(1);
+        }
+
+        kbc_buffer_pop(&state_data);
+        state = KBC_STATE_KEYBOARD;
+        kbc_on_output_empty(kbc);
+    }
+}
+
 void kbc_event(struct Kbc *kbc) {
     uint8_t sts;
 
@@ -507,9 +685,8 @@ void kbc_event(struct Kbc *kbc) {
     }
 
     // Read command/data while available
-    sts = kbc_status(kbc);
-    if (sts & KBC_STS_IBF) {
-        uint8_t data = kbc_read(kbc);
+    uint8_t data;
+    if (host_input_pop(&kbc_input, &KBHISR, &KBHIDIR, &sts, &data)) {
         if (sts & KBC_STS_CMD) {
             kbc_on_input_command(kbc, data);
         } else {
@@ -517,7 +694,8 @@ void kbc_event(struct Kbc *kbc) {
         }
     }
     // Write data if possible
-    else if (!(sts & KBC_STS_OBF)) {
+    else if (!(kbc_status(kbc) & KBC_STS_OBF)) {
         kbc_on_output_empty(kbc);
+        kbc_burst(kbc);
     }
 }
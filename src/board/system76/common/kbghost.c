@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Ghost detection of the keyboard scan: finds rows with two or more pressed
+// keys in the same columns as another row, using the scanned matrix only.
+
+#include <board/kbghost.h>
+
+static inline bool popcount_more_than_one(uint8_t rowdata) {
+    return rowdata & (rowdata - 1);
+}
+
+bool kbghost_in_row(
+    const uint8_t __xdata *matrix,
+    const uint8_t __code *real_keys,
+    uint8_t count,
+    uint8_t row
+) {
+    // Remove any "active" blanks from the matrix.
+    uint8_t rowdata = matrix[row] & real_keys[row];
+
+    // No ghosts exist when  less than 2 keys in the row are active.
+    if (!popcount_more_than_one(rowdata)) {
+        return false;
+    }
+
+    // Check against other rows to see if more than one column matches.
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t otherrow = matrix[i] & real_keys[i];
+        if (i != row && popcount_more_than_one(otherrow & rowdata)) {
+            return true;
+        }
+    }
+
+    return false;
+}
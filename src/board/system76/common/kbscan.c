@@ -7,6 +7,7 @@
 #include <board/gpio.h>
 #include <board/keymap.h>
 #include <board/kbc.h>
+#include <board/kbghost.h>
 #include <board/kbled.h>
 #include <board/kbscan.h>
 #include <board/lid.h>
@@ -14,6 +15,9 @@
 #include <board/power.h>
 #include <common/macro.h>
 #include <common/debug.h>
+#include <ec/intc.h>
+#include <ec/wuc.h>
+#include <keymask.h>
 
 // Default to not n-key rollover
 #ifndef KM_NKEY
@@ -29,6 +33,55 @@ uint16_t kbscan_repeat_delay = 500;
 
 uint8_t kbscan_matrix[KM_OUT] = { 0 };
 
+// Raw matrix state, captured once per scan
+static uint8_t kbscan_frame[KM_OUT] = { 0 };
+
+uint32_t kbscan_time = 0;
+
+// Debounce time in milliseconds. Changes are reported on the first edge, and
+// the key ignores further changes until this has elapsed. The window is kept
+// per output, so any edge reported on the same output restarts it for every
+// key of that output that is still debouncing.
+#ifndef DEBOUNCE_DELAY
+#define DEBOUNCE_DELAY 15
+#endif // DEBOUNCE_DELAY
+
+#if DEBOUNCE_DELAY > 255
+#error "DEBOUNCE_DELAY must fit in 8 bits"
+#endif
+
+// Keys that are debouncing, for each output
+static uint8_t kbscan_debounce[KM_OUT] = { 0 };
+// Time the last change of each output was reported, in ms, shared by all keys
+// of the output to save memory
+static uint8_t kbscan_debounce_time[KM_OUT] = { 0 };
+
+// Worst case time for inputs to settle after selecting an output, in ticks.
+// Boards can set this from the result of a calibration.
+#ifndef KBSCAN_SETTLE
+#define KBSCAN_SETTLE 20
+#endif // KBSCAN_SETTLE
+
+// Worst case time for inputs to settle after driving all outputs, in ticks
+#ifndef KBSCAN_RELEASE
+#define KBSCAN_RELEASE 10
+#endif // KBSCAN_RELEASE
+
+// Ticks added to a calibrated settle time
+#define KBSCAN_SETTLE_MARGIN 2
+// Readings that must match for a settle time to be considered reliable
+#define KBSCAN_CALIBRATE_SAMPLES 4
+// Calibration value of an output that was not measured
+#define KBSCAN_CALIBRATE_NONE 0xFF
+
+uint8_t kbscan_settle[KM_OUT] = { 0 };
+uint8_t kbscan_release = KBSCAN_RELEASE;
+
+bool kbscan_calibrating = false;
+uint8_t kbscan_calibration[KM_OUT] = { 0 };
+// Output to calibrate on the next scan
+static uint8_t kbscan_calibrate_row = 0;
+
 uint8_t sci_extra = 0;
 
 bool camera_switch_enabled = true;
@@ -41,6 +94,39 @@ static inline bool matrix_position_is_fn(uint8_t row, uint8_t col) {
     return (row == MATRIX_FN_OUTPUT) && (col == MATRIX_FN_INPUT);
 }
 
+// Drive all lines low, so any pressed key pulls its input low
+static void kbscan_drive_all(void) {
+    KSOLGOEN = 0xFF;
+    KSOHGOEN = 0xFF;
+#if KM_OUT >= 17
+    GPCRC3 = GPIO_OUT;
+    GPDRC &= ~BIT(3);
+#endif
+#if KM_OUT >= 18
+    GPCRC5 = GPIO_OUT;
+    GPDRC &= ~BIT(5);
+#endif
+}
+
+static bool kbscan_matrix_empty(void) {
+    for (uint8_t i = 0; i < KM_OUT; i++) {
+        if (kbscan_matrix[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Finish debounce of outputs whose window has elapsed
+static void kbscan_debounce_update(uint8_t time) {
+    for (uint8_t i = 0; i < KM_OUT; i++) {
+        if (kbscan_debounce[i] &&
+            (uint8_t)(time - kbscan_debounce_time[i]) >= DEBOUNCE_DELAY) {
+            kbscan_debounce[i] = 0;
+        }
+    }
+}
+
 void kbscan_init(void) {
     KSOCTRL = 0x05;
     KSICTRLR = 0x04;
@@ -58,17 +144,30 @@ void kbscan_init(void) {
     KSIGCTRL = 0;
     KSIGOEN = 0;
     KSIGDAT = 0;
-}
 
-// Debounce time in milliseconds
-#define DEBOUNCE_DELAY 15
+    for (uint8_t i = 0; i < KM_OUT; i++) {
+        kbscan_settle[i] = KBSCAN_SETTLE;
+        kbscan_calibration[i] = KBSCAN_CALIBRATE_NONE;
+    }
+    kbscan_release = KBSCAN_RELEASE;
 
-static uint8_t kbscan_get_row(uint8_t i) {
-    // Report all keys as released when lid is closed
-    if (!lid_state) {
-        return 0;
+    kbscan_drive_all();
+
+    // Wake on falling edge of any input
+    WUEMR3 = 0xFF;
+    WUESR3 = 0xFF;
+    WUENR3 = 0xFF;
+    intc_enable(INTC_IRQ_WKINTC);
+}
+
+// Delay that allows a delay of 0, which delay_ticks treats as a full period
+static void kbscan_delay(uint8_t ticks) {
+    if (ticks) {
+        delay_ticks(ticks);
     }
+}
 
+static void kbscan_select_row(uint8_t i) {
     // Set current line as output
     if (i < 8) {
         KSOLGOEN = BIT(i);
@@ -113,57 +212,96 @@ static uint8_t kbscan_get_row(uint8_t i) {
 #if KM_OUT >= 18
     GPDRC &= ~BIT(5);
 #endif
+}
 
-    // TODO: figure out optimal delay
-    delay_ticks(20);
+static uint8_t kbscan_get_row(uint8_t i) {
+    // Report all keys as released when lid is closed
+    if (!lid_state) {
+        return 0;
+    }
 
-    return ~KSI;
-}
+    kbscan_select_row(i);
 
-#if KM_NKEY
-static bool kbscan_has_ghost_in_row(uint8_t row, uint8_t rowdata) {
-    // Use arguments
-    row = row;
-    rowdata = rowdata;
-    return false;
-}
-#else // KM_NKEY
-static inline bool popcount_more_than_one(uint8_t rowdata) {
-    return rowdata & (rowdata - 1);
+    // Use the worst case while calibrating, as the result is the reference
+    kbscan_delay(kbscan_calibrating ? KBSCAN_SETTLE : kbscan_settle[i]);
+
+    return ~KSI;
 }
 
-static uint8_t kbscan_get_real_keys(uint8_t row, uint8_t rowdata) {
-    // Remove any "active" blanks from the matrix.
-    uint8_t realdata = 0;
-    for (uint8_t col = 0; col < KM_IN; col++) {
-        // This tests the default keymap intentionally, to avoid blanks in the
-        // dynamic keymap
-        if (KEYMAP[0][row][col] && (rowdata & BIT(col))) {
-            realdata |= BIT(col);
+// Find the shortest settle time that reads an output the same as the full
+// settle time. All outputs are driven before selecting it, so inputs held
+// low by keys on other outputs have to recover, which is the worst case.
+static void kbscan_calibrate(uint8_t i, uint8_t reference) {
+    // Shorter times were already unreliable for an earlier matrix state
+    uint8_t ticks = kbscan_calibration[i];
+    if (ticks == KBSCAN_CALIBRATE_NONE) {
+        ticks = 0;
+    }
+    for (; ticks < KBSCAN_SETTLE; ticks++) {
+        uint8_t sample;
+        for (sample = 0; sample < KBSCAN_CALIBRATE_SAMPLES; sample++) {
+            kbscan_drive_all();
+            kbscan_delay(KBSCAN_RELEASE);
+            kbscan_select_row(i);
+            kbscan_delay(ticks);
+            if ((uint8_t)~KSI != reference) {
+                break;
+            }
+        }
+        if (sample == KBSCAN_CALIBRATE_SAMPLES) {
+            kbscan_calibration[i] = ticks;
+            return;
         }
     }
-
-    return realdata;
+    kbscan_calibration[i] = KBSCAN_SETTLE;
 }
 
-static bool kbscan_has_ghost_in_row(uint8_t row, uint8_t rowdata) {
-    rowdata = kbscan_get_real_keys(row, rowdata);
+void kbscan_calibrate_start(void) {
+    for (uint8_t i = 0; i < KM_OUT; i++) {
+        kbscan_calibration[i] = KBSCAN_CALIBRATE_NONE;
+    }
+    kbscan_calibrate_row = 0;
+    kbscan_calibrating = true;
+}
 
-    // No ghosts exist when  less than 2 keys in the row are active.
-    if (!popcount_more_than_one(rowdata)) {
-        return false;
+void kbscan_calibrate_stop(bool apply) {
+    kbscan_calibrating = false;
+    if (!apply) {
+        return;
     }
 
-    // Check against other rows to see if more than one column matches.
+    uint8_t release = 0;
     for (uint8_t i = 0; i < KM_OUT; i++) {
-        uint8_t otherrow = kbscan_get_real_keys(i, kbscan_get_row(i));
-        if (i != row && popcount_more_than_one(otherrow & rowdata)) {
-            return true;
+        // Outputs that were not measured keep their settle time
+        if (kbscan_calibration[i] != KBSCAN_CALIBRATE_NONE) {
+            uint8_t settle = kbscan_calibration[i] + KBSCAN_SETTLE_MARGIN;
+            if (settle > KBSCAN_SETTLE) {
+                settle = KBSCAN_SETTLE;
+            }
+            kbscan_settle[i] = settle;
+        }
+        if (kbscan_settle[i] > release) {
+            release = kbscan_settle[i];
         }
     }
+    // Inputs fall when all outputs are driven as fast as when one is selected
+    kbscan_release = release < KBSCAN_RELEASE ? release : KBSCAN_RELEASE;
+}
 
+#if KM_NKEY
+static bool kbscan_has_ghost_in_row(uint8_t row) {
+    // Use arguments
+    row = row;
     return false;
 }
+#else // KM_NKEY
+// Keys in the default keymap, generated at build time. This uses the default
+// keymap intentionally, to avoid blanks in the dynamic keymap
+static const uint8_t __code kbscan_real_keys[KM_OUT] = KEYMASK;
+
+static bool kbscan_has_ghost_in_row(uint8_t row) {
+    return kbghost_in_row(kbscan_frame, kbscan_real_keys, KM_OUT, row);
+}
 #endif // KM_NKEY
 
 static void hardware_hotkey(uint16_t key) {
@@ -196,6 +334,33 @@ static void hardware_hotkey(uint16_t key) {
     }
 }
 
+// Scancode sequences of combos, queued whole so that a full buffer does not
+// leave a key of the sequence pressed
+static const struct KbcKey __code combo_display_mode[] = {
+    { K_LEFT_SUPER, true },
+    { K_P, true },
+    { K_P, false },
+};
+
+static const struct KbcKey __code combo_print_screen_press[] = {
+    { KF_E0 | 0x12, true },
+    { KF_E0 | 0x7C, true },
+};
+
+static const struct KbcKey __code combo_print_screen_release[] = {
+    { KF_E0 | 0x7C, false },
+    { KF_E0 | 0x12, false },
+};
+
+static const struct KbcKey __code combo_pause[] = {
+    { 0xE1, true },
+    { 0x14, true },
+    { 0x77, true },
+    { 0xE1, true },
+    { 0x14, false },
+    { 0x77, false },
+};
+
 bool kbscan_press(uint16_t key, bool pressed, uint8_t *layer) {
     // Wake from sleep on keypress
     if (pressed && lid_state && (power_state == POWER_STATE_S3)) {
@@ -211,7 +376,10 @@ bool kbscan_press(uint16_t key, bool pressed, uint8_t *layer) {
     switch (key & KT_MASK) {
     case (KT_NORMAL):
         if (kbscan_enabled) {
-            kbc_scancode(key, pressed);
+            if (!kbc_scancode(key, pressed)) {
+                // In the case of a full buffer, reset bit to retry
+                return false;
+            }
         }
         break;
     case (KT_FN):
@@ -230,41 +398,54 @@ bool kbscan_press(uint16_t key, bool pressed, uint8_t *layer) {
         case COMBO_DISPLAY_MODE:
             if (kbscan_enabled) {
                 if (pressed) {
-                    kbc_scancode(K_LEFT_SUPER, true);
-                    kbc_scancode(K_P, true);
-                    kbc_scancode(K_P, false);
-                } else {
-                    kbc_scancode(K_LEFT_SUPER, false);
+                    if (!kbc_scancodes(combo_display_mode, ARRAY_SIZE(combo_display_mode))) {
+                        // In the case of a full buffer, reset bit to retry
+                        return false;
+                    }
+                } else if (!kbc_scancode(K_LEFT_SUPER, false)) {
+                    // In the case of a full buffer, reset bit to retry
+                    return false;
                 }
             }
             break;
         case COMBO_PRINT_SCREEN:
             if (kbscan_enabled) {
+                bool queued;
                 if (pressed) {
-                    kbc_scancode(KF_E0 | 0x12, true);
-                    kbc_scancode(KF_E0 | 0x7C, true);
+                    queued = kbc_scancodes(
+                        combo_print_screen_press,
+                        ARRAY_SIZE(combo_print_screen_press)
+                    );
                 } else {
-                    kbc_scancode(KF_E0 | 0x7C, false);
-                    kbc_scancode(KF_E0 | 0x12, false);
+                    queued = kbc_scancodes(
+                        combo_print_screen_release,
+                        ARRAY_SIZE(combo_print_screen_release)
+                    );
+                }
+                if (!queued) {
+                    // In the case of a full buffer, reset bit to retry
+                    return false;
                 }
             }
             break;
         case COMBO_PAUSE:
             if (kbscan_enabled) {
                 if (pressed) {
-                    kbc_scancode(0xE1, true);
-                    kbc_scancode(0x14, true);
-                    kbc_scancode(0x77, true);
-                    kbc_scancode(0xE1, true);
-                    kbc_scancode(0x14, false);
-                    kbc_scancode(0x77, false);
+                    if (!kbc_scancodes(combo_pause, ARRAY_SIZE(combo_pause))) {
+                        // In the case of a full buffer, reset bit to retry
+                        return false;
+                    }
                 }
             }
             break;
         case COMBO_TOUCHPAD:
             // Not actually a combo, just sends a keypress and an SCI
-            if (kbscan_enabled)
-                kbc_scancode(KF_E0 | 0x63, pressed);
+            if (kbscan_enabled) {
+                if (!kbc_scancode(KF_E0 | 0x63, pressed)) {
+                    // In the case of a full buffer, reset bit to retry
+                    return false;
+                }
+            }
 
             if (pressed && acpi_ecos != EC_OS_NONE) {
                 if (!pmc_sci(&PMC_1, 0x0A)) {
@@ -330,40 +511,84 @@ static inline bool key_should_repeat(uint16_t key) {
     return true;
 }
 
+bool kbscan_pending(void) {
+    // Input edge since last scan
+    if (WUESR3) {
+        return true;
+    }
+    // Key held, with all lines driven
+    if (lid_state && KSI != 0xFF) {
+        return true;
+    }
+    // Release not yet reported
+    if (!kbscan_matrix_empty()) {
+        return true;
+    }
+    // Debounce must finish before the 8-bit timestamps wrap
+    for (uint8_t i = 0; i < KM_OUT; i++) {
+        if (kbscan_debounce[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void kbscan_event(void) {
     static uint8_t kbscan_layer = 0;
     uint8_t layer = kbscan_layer;
     static uint8_t kbscan_last_layer[KM_OUT][KM_IN] = { { 0 } };
     static bool kbscan_ghost[KM_OUT] = { false };
 
-    static bool debounce = false;
-    static uint32_t debounce_time = 0;
-
     static bool repeat = false;
     static uint16_t repeat_key = 0;
     static uint32_t repeat_key_time = 0;
 
-    // If debounce complete
-    if (debounce) {
-        uint32_t time = time_get();
-        if ((time - debounce_time) >= DEBOUNCE_DELAY) {
-            // Finish debounce
-            debounce = false;
+    uint8_t debounce_time = (uint8_t)time_get();
+    kbscan_debounce_update(debounce_time);
+
+    // Clear input edges, any new press after this is seen by the scan
+    WUESR3 = 0xFF;
+
+    // All lines are driven between scans, so no input is low when nothing
+    // is pressed. Skip the scan if no key was held either.
+    if ((KSI == 0xFF || !lid_state) && kbscan_matrix_empty()) {
+        return;
+    }
+
+    // Transitions found by this scan are detected now
+    kbscan_time = time_get_ticks();
+
+    // Capture the matrix once, so ghost detection does not rescan it
+    bool frame_empty = true;
+    for (uint8_t i = 0; i < KM_OUT; i++) {
+        kbscan_frame[i] = kbscan_get_row(i);
+        if (kbscan_frame[i]) {
+            frame_empty = false;
+        }
+    }
+
+    // Settle times can only be measured while keys are held. Calibrate one
+    // output per scan to bound the time spent.
+    if (kbscan_calibrating && lid_state && !frame_empty) {
+        kbscan_calibrate(kbscan_calibrate_row, kbscan_frame[kbscan_calibrate_row]);
+        kbscan_calibrate_row++;
+        if (kbscan_calibrate_row >= KM_OUT) {
+            kbscan_calibrate_row = 0;
         }
     }
 
     for (uint8_t i = 0; i < KM_OUT; i++) {
-        uint8_t new = kbscan_get_row(i);
+        uint8_t new = kbscan_frame[i];
         uint8_t last = kbscan_matrix[i];
         if (new != last) {
-            if (kbscan_has_ghost_in_row(i, new)) {
+            if (kbscan_has_ghost_in_row(i)) {
                 kbscan_ghost[i] = true;
                 continue;
             } else if (kbscan_ghost[i]) {
                 kbscan_ghost[i] = false;
-                // Debounce to allow remaining ghosts to settle.
-                debounce = true;
-                debounce_time = time_get();
+                // Debounce the row to allow remaining ghosts to settle.
+                kbscan_debounce[i] = 0xFF;
+                kbscan_debounce_time[i] = debounce_time;
             }
 
             // A key was pressed or released
@@ -376,13 +601,13 @@ void kbscan_event(void) {
                     bool reset = false;
 
                     // If debouncing
-                    if (debounce) {
+                    if (kbscan_debounce[i] & BIT(j)) {
                         // Debounce presses and releases
                         reset = true;
                     } else {
-                        // Begin debounce
-                        debounce = true;
-                        debounce_time = time_get();
+                        // Report the change now, and ignore bounces after it
+                        kbscan_debounce[i] |= BIT(j);
+                        kbscan_debounce_time[i] = debounce_time;
 
                         // Check keys used for config reset
                         if (matrix_position_is_esc(i, j))
@@ -403,6 +628,8 @@ void kbscan_event(void) {
                             if (!kbscan_press(key, new_b, &layer)) {
                                 // In the case of ignored key press/release, reset bit
                                 reset = true;
+                                // Retry on the next scan instead of after debounce
+                                kbscan_debounce[i] &= ~BIT(j);
                             }
 
                             if (new_b) {
@@ -459,16 +686,10 @@ void kbscan_event(void) {
 
     kbscan_layer = layer;
 
-    // Reset all lines to inputs
-    KSOLGOEN = 0;
-    KSOHGOEN = 0;
-#if KM_OUT >= 17
-    GPCRC3 = GPIO_IN;
-#endif
-#if KM_OUT >= 18
-    GPCRC5 = GPIO_IN;
-#endif
+    kbscan_drive_all();
+
+    kbscan_delay(kbscan_release);
 
-    // TODO: figure out optimal delay
-    delay_ticks(10);
+    // Ignore input edges caused by the scan itself
+    WUESR3 = 0xFF;
 }
@@ -0,0 +1,24 @@
+# SPDX-License-Identifier: GPL-3.0-only
+
+# Generate a mask of the keys in the keymap, used by ghost detection
+
+KEYMASK_DIR=$(SYSTEM76_COMMON_DIR)/keymask
+KEYMASK_BUILD=$(BUILD)/keymask
+KEYMASK_SRC=$(KEYMASK_DIR)/main.c $(KEYBOARD_DIR)/keymap/$(KEYMAP).c
+HOSTCC?=gcc
+
+# Run host program to generate C header
+$(BUILD)/include/keymask.h: $(KEYMASK_BUILD)/keymask
+	@echo "  KEYMASK   $(subst $(obj)/,,$@)"
+	mkdir -p $(@D)
+	$< > $@
+
+# Compile host program with the keymap
+$(KEYMASK_BUILD)/keymask: $(KEYMASK_SRC) $(KEYBOARD_DIR)/include/board/keymap.h
+	@echo "  HOSTCC    $(subst $(obj)/,,$@)"
+	mkdir -p $(@D)
+	$(HOSTCC) $(CFLAGS) -D__code= -D__xdata= -o $@ $(KEYMASK_SRC)
+
+# Include keymask header in main firmware
+CFLAGS+=-I$(BUILD)/include
+INCLUDE+=$(BUILD)/include/keymask.h
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: GPL-3.0-only
+//
+// Host program that prints the matrix positions populated in the default
+// layer of the keymap, as a mask of inputs for each output. Blank positions
+// are ignored by the keyboard ghost detection.
+
+#include <stdio.h>
+
+#include <board/keymap.h>
+
+int main(void) {
+    printf("// Generated from the keymap, do not edit\n\n");
+    printf("#ifndef _KEYMASK_H\n");
+    printf("#define _KEYMASK_H\n\n");
+    printf("// Populated inputs of each output in the default layer\n");
+    printf("#define KEYMASK { \\\n");
+    for (int output = 0; output < KM_OUT; output++) {
+        unsigned int mask = 0;
+        for (int input = 0; input < KM_IN; input++) {
+            if (KEYMAP[0][output][input]) {
+                mask |= 1U << input;
+            }
+        }
+        printf("    0x%02X, \\\n", mask);
+    }
+    printf("}\n\n");
+    printf("#endif // _KEYMASK_H\n");
+    return 0;
+}
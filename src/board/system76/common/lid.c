@@ -37,6 +37,8 @@ void lid_event(void) {
     }
     lid_state = new;
 
+    acpi_update_lid();
+
     if (send_sci) {
         // Send SCI 0x1B for lid event if ACPI OS is loaded
         if (acpi_ecos != EC_OS_NONE) {
@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include <common/log.h>
+
+static void log_bytes(const void *data, uint8_t size) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (uint8_t i = 0; i < size; i++) {
+        putchar(bytes[i]);
+    }
+}
+
+void log_token(uint16_t id, const char *spec, ...) {
+    va_list ap;
+
+    putchar(LOG_TOKEN_MARKER);
+    log_bytes(&id, sizeof(id));
+
+    va_start(ap, spec);
+    for (; *spec; spec++) {
+        switch (*spec) {
+        case LOG_ARG_CHAR: {
+            char value = va_arg(ap, char);
+            log_bytes(&value, sizeof(value));
+            break;
+        }
+        case LOG_ARG_INT: {
+            int value = va_arg(ap, int);
+            log_bytes(&value, sizeof(value));
+            break;
+        }
+        case LOG_ARG_LONG: {
+            long value = va_arg(ap, long);
+            log_bytes(&value, sizeof(value));
+            break;
+        }
+        case LOG_ARG_LONG_LONG: {
+            long long value = va_arg(ap, long long);
+            log_bytes(&value, sizeof(value));
+            break;
+        }
+        case LOG_ARG_POINTER: {
+            void *value = va_arg(ap, void *);
+            log_bytes(&value, sizeof(value));
+            break;
+        }
+        case LOG_ARG_STRING: {
+            const char *value = va_arg(ap, const char *);
+            do {
+                putchar(*value);
+            } while (*value++);
+            break;
+        }
+        }
+    }
+    va_end(ap);
+}
@@ -0,0 +1,16 @@
+# SPDX-License-Identifier: GPL-3.0-only
+
+# Generate the tokens of log calls, and the dictionary used to decode them
+
+LOG_TOKENS_SCRIPT=scripts/log_tokens.py
+
+# Sources are only known once all makefiles are included
+.SECONDEXPANSION:
+$(BUILD)/include/log_tokens.h: $(LOG_TOKENS_SCRIPT) $$(filter %.c, $$(SRC))
+	@echo "  LOGTOKENS $(subst $(obj)/,,$@)"
+	mkdir -p $(@D)
+	python3 $(LOG_TOKENS_SCRIPT) $@ $(BUILD)/log_tokens.txt $(filter %.c, $(SRC))
+
+# Include log tokens header in main firmware
+CFLAGS+=-I$(BUILD)/include
+INCLUDE+=$(BUILD)/include/log_tokens.h
@@ -13,6 +13,7 @@
 #include <board/fan.h>
 #include <board/gpio.h>
 #include <board/gctrl.h>
+#include <board/idle.h>
 #include <board/kbc.h>
 #include <board/kbled.h>
 #include <board/kbscan.h>
@@ -26,6 +27,8 @@
 #include <board/pwm.h>
 #include <board/smbus.h>
 #include <board/smfi.h>
+#include <board/task.h>
+#include <board/telemetry.h>
 #include <board/usbpd.h>
 #include <common/debug.h>
 #include <common/macro.h>
@@ -39,17 +42,12 @@
 void external_0(void) __interrupt(0) {}
 // timer_0 is in time.c
 void timer_0(void) __interrupt(1);
-void external_1(void) __interrupt(2) {}
+// external_1 is in idle.c
+void external_1(void) __interrupt(2);
 void timer_1(void) __interrupt(3) {}
 void serial(void) __interrupt(4) {}
 void timer_2(void) __interrupt(5) {}
 
-uint8_t main_cycle = 0;
-const uint16_t battery_interval = 1000;
-// update fan speed more frequently for smoother fans
-// NOTE: event loop is longer than 100ms and maybe even longer than 250
-const uint16_t fan_interval = SMOOTH_FANS != 0 ? 250 : 1000;
-
 void init(void) {
     // Must happen first
     arch_init();
@@ -80,10 +78,11 @@ void init(void) {
     pwm_init();
     smbus_init();
     smfi_init();
+    telemetry_init();
     usbpd_init();
     ps2_init();
 
-    //TODO: INTC
+    idle_init();
 
     // Must happen last
     power_init();
@@ -102,62 +101,14 @@ void main(void) {
     INFO("System76 EC board '%s', version '%s'\n", board(), version());
     ec_print_reset_reason();
 
-    uint32_t last_time_battery = 0;
-    uint32_t last_time_fan = 0;
-
-    for (main_cycle = 0;; main_cycle++) {
-        switch (main_cycle % 3U) {
-        case 0:
-            // Handle USB-C events immediately before power states
-            usbpd_event();
-
-            // Handle power states
-            power_event();
-            break;
-        case 1:
-#if PARALLEL_DEBUG
-            if (!parallel_debug)
-#endif // PARALLEL_DEBUG
-            {
-                // Scans keyboard and sends keyboard packets
-                kbscan_event();
-            }
-            break;
-        case 2:
-            // Handle lid close/open
-            lid_event();
-            break;
-        }
-
-        if (main_cycle == 0) {
-            uint32_t time = time_get();
-            // Only run the following once per interval
-            if ((time - last_time_fan) >= fan_interval) {
-                last_time_fan = time;
-
-                // Update fan speeds
-                fan_duty_set(peci_get_fan_duty(), dgpu_get_fan_duty());
-            }
-
-            // Only run the following once per interval
-            if ((time - last_time_battery) >= battery_interval) {
-                last_time_battery = time;
-
-                // Updates battery status
-                battery_event();
-            }
+    for (;;) {
+        // Run the most urgent task that is due
+        if (!task_run()) {
+            // Idle until next interrupt if no task was due
+            idle_wait();
         }
 
-        // Board-specific events
-        board_event();
-
-        // Checks for keyboard/mouse packets from host
-        kbc_event(&KBC);
-        // Handles ACPI communication
-        pmc_event(&PMC_1);
-        // AP/EC communication over SMFI
-        smfi_event();
-        // Idle until next timer interrupt
-        //Disabled until interrupts used: PCON |= 1;
+        // Track time spent idle
+        idle_event();
     }
 }
@@ -1,9 +1,11 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <stddef.h>
+
 #include <arch/time.h>
-#include <arch/delay.h>
 #include <board/acpi.h>
 #include <board/gpio.h>
+#include <board/host_input.h>
 #include <board/pmc.h>
 #include <common/macro.h>
 #include <common/debug.h>
@@ -28,169 +30,351 @@ enum PmcState {
     PMC_STATE_ACPI_WRITE_ADDR,
 };
 
-static uint8_t pmc_sci_queue = 0;
+// PMC_1 is used by the OS ACPI driver, and notified of handshake steps and
+// events with SCIs. PMC_2 is a second host interface for tools and drivers,
+// with the same commands. It is polled by the host, so it sends no SCIs and
+// does not serve SCI queries. Each has its own state machine.
+struct PmcChannel {
+    // Channel of the OS ACPI driver
+    bool acpi;
+    enum PmcState state;
+    uint8_t state_data;
+};
 
-static void pmc_sci_interrupt(void) {
-#if CONFIG_BUS_ESPI
-    // Start SCI interrupt
-    vw_set(&VW_SCI_N, VWS_LOW);
+static struct PmcChannel pmc_1_channel = {
+    .acpi = true,
+    .state = PMC_STATE_DEFAULT,
+    .state_data = 0,
+};
 
-    // Delay T_HOLD (value assumed)
-    delay_us(65);
+static struct PmcChannel pmc_2_channel = {
+    .acpi = false,
+    .state = PMC_STATE_DEFAULT,
+    .state_data = 0,
+};
 
-    // Stop SCI interrupt
-    vw_set(&VW_SCI_N, VWS_HIGH);
+static struct PmcChannel *pmc_channel(struct Pmc *pmc) {
+    if (pmc == &PMC_2) {
+        return &pmc_2_channel;
+    }
+    return &pmc_1_channel;
+}
 
-    // Delay T_HOLD (value assumed)
-    delay_us(65);
-#else // CONFIG_BUS_ESPI
-    // Start SCI interrupt
-    gpio_set(&SCI_N, false);
-    *(SCI_N.control) = GPIO_OUT;
+// SCI events waiting for the OS to query them. Must be a power of two.
+#define PMC_SCI_QUEUE_SIZE 8
+#define PMC_SCI_QUEUE_MASK (PMC_SCI_QUEUE_SIZE - 1)
+
+static uint8_t pmc_sci_queue[PMC_SCI_QUEUE_SIZE] = { 0 };
+// Value of sci_extra for each queued event
+static uint8_t pmc_sci_queue_extra[PMC_SCI_QUEUE_SIZE] = { 0 };
+// Free running indexes, masked on access
+static uint8_t pmc_sci_queue_head = 0;
+static uint8_t pmc_sci_queue_tail = 0;
+
+extern uint8_t sci_extra;
+
+// Events that report a state the OS reads when handling them, so one
+// pending event is enough
+static bool pmc_sci_coalesce(uint8_t sci) {
+    switch (sci) {
+    case 0x16: // AC adapter
+    case 0x1B: // Lid
+    case 0xA0: // GPU power limit
+        return true;
+    }
+    return false;
+}
 
-    // Delay T_HOLD (value assumed)
-    delay_us(65);
+static bool pmc_sci_queued(uint8_t sci) {
+    for (uint8_t i = pmc_sci_queue_head; i != pmc_sci_queue_tail; i++) {
+        if (pmc_sci_queue[i & PMC_SCI_QUEUE_MASK] == sci) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    // Stop SCI interrupt
-    *(SCI_N.control) = GPIO_IN;
-    gpio_set(&SCI_N, true);
+static uint8_t pmc_sci_pop(void) {
+    if (pmc_sci_queue_head == pmc_sci_queue_tail) {
+        return 0;
+    }
+    uint8_t i = pmc_sci_queue_head & PMC_SCI_QUEUE_MASK;
+    pmc_sci_queue_head++;
+    sci_extra = pmc_sci_queue_extra[i];
+    acpi_update_sci();
+    return pmc_sci_queue[i];
+}
+
+struct PmcStats pmc_stats = { 0 };
+
+// T_HOLD of SCI and PME pulses (value assumed), in ticks
+#define PMC_PULSE_HOLD ((65UL * TIME_TICKS_PER_MS + 999UL) / 1000UL)
+
+enum PmcPulseState {
+    PMC_PULSE_IDLE,
+    // Line is asserted for T_HOLD
+    PMC_PULSE_ASSERT,
+    // Line is released for T_HOLD
+    PMC_PULSE_RELEASE,
+};
+
+// SCI and PME pulses are timed by the main loop instead of busy waiting
+struct PmcPulse {
+    enum PmcPulseState state;
+    // Another pulse was requested while this one was in progress
+    bool again;
+    // Time the current phase started, in ticks
+    uint32_t start;
+    // Drive the line, active low
+    void (*set)(bool level);
+};
 
-    // Delay T_HOLD (value assumed)
-    delay_us(65);
+static void pmc_sci_set(bool level) {
+#if CONFIG_BUS_ESPI
+    vw_set(&VW_SCI_N, level ? VWS_HIGH : VWS_LOW);
+#else // CONFIG_BUS_ESPI
+    if (level) {
+        *(SCI_N.control) = GPIO_IN;
+        gpio_set(&SCI_N, true);
+    } else {
+        gpio_set(&SCI_N, false);
+        *(SCI_N.control) = GPIO_OUT;
+    }
+#endif // CONFIG_BUS_ESPI
+}
+
+static void pmc_swi_set(bool level) {
+#if CONFIG_BUS_ESPI
+    vw_set(&VW_PME_N, level ? VWS_HIGH : VWS_LOW);
+#else // CONFIG_BUS_ESPI
+    gpio_set(&SWI_N, level);
 #endif // CONFIG_BUS_ESPI
 }
 
+static struct PmcPulse pmc_sci_pulse = {
+    .state = PMC_PULSE_IDLE,
+    .again = false,
+    .start = 0,
+    .set = pmc_sci_set,
+};
+
+static struct PmcPulse pmc_swi_pulse = {
+    .state = PMC_PULSE_IDLE,
+    .again = false,
+    .start = 0,
+    .set = pmc_swi_set,
+};
+
+static void pmc_pulse_start(struct PmcPulse *pulse) {
+    if (pulse->state != PMC_PULSE_IDLE) {
+        // The host may have already handled this pulse, so send another
+        pulse->again = true;
+        return;
+    }
+    pulse->set(false);
+    pulse->state = PMC_PULSE_ASSERT;
+    pulse->start = time_get_ticks();
+}
+
+static void pmc_pulse_update(struct PmcPulse *pulse) {
+    if (pulse->state == PMC_PULSE_IDLE) {
+        return;
+    }
+    if (time_elapsed_ticks(pulse->start) < PMC_PULSE_HOLD) {
+        return;
+    }
+    if (pulse->state == PMC_PULSE_ASSERT) {
+        pulse->set(true);
+        pulse->state = PMC_PULSE_RELEASE;
+        pulse->start = time_get_ticks();
+    } else {
+        pulse->state = PMC_PULSE_IDLE;
+        if (pulse->again) {
+            pulse->again = false;
+            pmc_pulse_start(pulse);
+        }
+    }
+}
+
+static void pmc_sci_interrupt(void) {
+    pmc_stats.sci++;
+    pmc_pulse_start(&pmc_sci_pulse);
+}
+
+// SCI for a change of the status register, only sent on the ACPI channel
+static void pmc_status_sci(struct PmcChannel *channel) {
+    if (channel->acpi) {
+        pmc_sci_interrupt();
+    }
+}
+
+// SCI for a handshake step (IBF=0 or OBF=1). In burst mode the host polls
+// the status instead, so no SCI is needed.
+static void pmc_handshake_sci(struct Pmc *pmc, struct PmcChannel *channel) {
+    if (!(pmc_status(pmc) & PMC_STS_BURST)) {
+        pmc_status_sci(channel);
+    }
+}
+
 bool pmc_sci(struct Pmc *pmc, uint8_t sci) {
+    // Already pending, the OS has been notified
+    if (pmc_sci_coalesce(sci) && pmc_sci_queued(sci)) {
+        return true;
+    }
+
+    // Queue is full, the caller has to retry
+    if ((uint8_t)(pmc_sci_queue_tail - pmc_sci_queue_head) >= PMC_SCI_QUEUE_SIZE) {
+        return false;
+    }
+
+    uint8_t i = pmc_sci_queue_tail & PMC_SCI_QUEUE_MASK;
+    pmc_sci_queue[i] = sci;
+    pmc_sci_queue_extra[i] = sci_extra;
+    pmc_sci_queue_tail++;
+
     // Set SCI pending bit
     pmc_set_status(pmc, pmc_status(pmc) | BIT(5));
 
     // Send SCI
     pmc_sci_interrupt();
 
-    // Set SCI queue if not already set
-    if (pmc_sci_queue == 0) {
-        pmc_sci_queue = sci;
-        return true;
-    } else {
-        return false;
-    }
+    return true;
 }
 
 void pmc_swi(void) {
-#if CONFIG_BUS_ESPI
-    // Start PME interrupt
-    vw_set(&VW_PME_N, VWS_LOW);
-
-    // Delay T_HOLD (value assumed)
-    delay_us(65);
-
-    // Stop PME interrupt
-    vw_set(&VW_PME_N, VWS_HIGH);
-
-    // Delay T_HOLD (value assumed)
-    delay_us(65);
-#else // CONFIG_BUS_ESPI
-    // Start SWI interrupt
-    gpio_set(&SWI_N, false);
+    pmc_stats.swi++;
+    pmc_pulse_start(&pmc_swi_pulse);
+}
 
-    // Delay T_HOLD (value assumed)
-    delay_us(65);
+static volatile struct HostInput pmc_1_input = { 0 };
+static volatile struct HostInput pmc_2_input = { 0 };
 
-    // Stop SWI interrupt
-    gpio_set(&SWI_N, true);
+static volatile struct HostInput *pmc_input(struct Pmc *pmc) {
+    if (pmc == &PMC_1) {
+        return &pmc_1_input;
+    } else if (pmc == &PMC_2) {
+        return &pmc_2_input;
+    }
+    return NULL;
+}
 
-    // Delay T_HOLD (value assumed)
-    delay_us(65);
-#endif // CONFIG_BUS_ESPI
+void pmc_interrupt(void) {
+    host_input_fill(&pmc_1_input, PMC_1.status, PMC_1.data_in);
+    host_input_fill(&pmc_2_input, PMC_2.status, PMC_2.data_in);
 }
 
-static enum PmcState state = PMC_STATE_DEFAULT;
-static uint8_t state_data = 0;
+static bool pmc_input_pop(struct Pmc *pmc, uint8_t *sts, uint8_t *data) {
+    volatile struct HostInput *input = pmc_input(pmc);
+    if (!input) {
+        // Not serviced by the interrupt
+        *sts = pmc_status(pmc);
+        if (!(*sts & PMC_STS_IBF)) {
+            return false;
+        }
+        *data = pmc_read(pmc);
+        return true;
+    }
+    return host_input_pop(input, pmc->status, pmc->data_in, sts, data);
+}
 
-static void pmc_on_input_command(struct Pmc *pmc, uint8_t data) {
+static void pmc_on_input_command(struct Pmc *pmc, struct PmcChannel *channel, uint8_t data) {
     TRACE("pmc cmd: %02X\n", data);
-    state = PMC_STATE_DEFAULT;
+    channel->state = PMC_STATE_DEFAULT;
     switch (data) {
     case 0x80:
-        state = PMC_STATE_ACPI_READ;
+        channel->state = PMC_STATE_ACPI_READ;
         // Send SCI for IBF=0
-        pmc_sci_interrupt();
+        pmc_handshake_sci(pmc, channel);
         break;
     case 0x81:
-        state = PMC_STATE_ACPI_WRITE;
+        channel->state = PMC_STATE_ACPI_WRITE;
         // Send SCI for IBF=0
-        pmc_sci_interrupt();
+        pmc_handshake_sci(pmc, channel);
         break;
     case 0x82:
         TRACE("  burst enable\n");
         // Set burst bit
-        pmc_set_status(pmc, pmc_status(pmc) | BIT(4));
+        pmc_set_status(pmc, pmc_status(pmc) | PMC_STS_BURST);
         // Send acknowledgement byte
-        state = PMC_STATE_WRITE;
-        state_data = 0x90;
+        channel->state = PMC_STATE_WRITE;
+        channel->state_data = 0x90;
         break;
     case 0x83:
         TRACE("  burst disable\n");
         // Clear burst bit
-        pmc_set_status(pmc, pmc_status(pmc) & ~BIT(4));
+        pmc_set_status(pmc, pmc_status(pmc) & ~PMC_STS_BURST);
         // Send SCI for IBF=0
-        pmc_sci_interrupt();
+        pmc_status_sci(channel);
         break;
     case 0x84:
         TRACE("  SCI queue\n");
-        // Clear SCI pending bit
-        pmc_set_status(pmc, pmc_status(pmc) & ~BIT(5));
-        // Send SCI queue
-        state = PMC_STATE_WRITE;
-        state_data = pmc_sci_queue;
-        // Clear SCI queue
-        pmc_sci_queue = 0;
+        channel->state = PMC_STATE_WRITE;
+        if (!channel->acpi) {
+            // SCI events are only sent to the OS
+            channel->state_data = 0;
+            break;
+        }
+        // Send next SCI event
+        channel->state_data = pmc_sci_pop();
+        pmc_stats.queries++;
+        // Clear SCI pending bit once all events are sent. Otherwise the OS
+        // queries again after the SCI for OBF=1.
+        if (pmc_sci_queue_head == pmc_sci_queue_tail) {
+            pmc_set_status(pmc, pmc_status(pmc) & ~BIT(5));
+        }
         break;
     }
 }
 
-static void pmc_on_input_data(uint8_t data) {
+static void pmc_on_input_data(struct Pmc *pmc, struct PmcChannel *channel, uint8_t data) {
     TRACE("pmc data: %02X\n", data);
-    switch (state) {
+    switch (channel->state) {
     case PMC_STATE_ACPI_READ:
         // Send byte from ACPI space
-        state = PMC_STATE_WRITE;
-        state_data = acpi_read(data);
+        channel->state = PMC_STATE_WRITE;
+        channel->state_data = acpi_read(data);
+        if (channel->acpi) {
+            pmc_stats.reads++;
+        }
         break;
     case PMC_STATE_ACPI_WRITE:
-        state = PMC_STATE_ACPI_WRITE_ADDR;
-        state_data = data;
+        channel->state = PMC_STATE_ACPI_WRITE_ADDR;
+        channel->state_data = data;
         // Send SCI for IBF=0
-        pmc_sci_interrupt();
+        pmc_handshake_sci(pmc, channel);
         break;
     case PMC_STATE_ACPI_WRITE_ADDR:
-        state = PMC_STATE_DEFAULT;
-        acpi_write(state_data, data);
+        channel->state = PMC_STATE_DEFAULT;
+        acpi_write(channel->state_data, data);
+        if (channel->acpi) {
+            pmc_stats.writes++;
+        }
         // Send SCI for IBF=0
-        pmc_sci_interrupt();
+        pmc_handshake_sci(pmc, channel);
         break;
     default:
-        state = PMC_STATE_DEFAULT;
+        channel->state = PMC_STATE_DEFAULT;
         break;
     }
 }
 
-static void pmc_on_output_empty(struct Pmc *pmc) {
-    switch (state) {
+static void pmc_on_output_empty(struct Pmc *pmc, struct PmcChannel *channel) {
+    switch (channel->state) {
     case PMC_STATE_WRITE:
-        TRACE("pmc write: %02X\n", state_data);
-        state = PMC_STATE_DEFAULT;
-        pmc_write(pmc, state_data);
+        TRACE("pmc write: %02X\n", channel->state_data);
+        channel->state = PMC_STATE_DEFAULT;
+        pmc_write(pmc, channel->state_data);
         // Send SCI for OBF=1
-        pmc_sci_interrupt();
+        pmc_handshake_sci(pmc, channel);
         break;
     }
 }
 
 #if PMC_S0IX_HACK
+static bool pmc_s0_hack2 = false;
+
 // HACK: Kick PMC to fix suspend on lemp11
 static void pmc_hack(void) {
-    static bool pmc_s0_hack2 = false;
     static uint32_t last_time = 0;
     // Get time the system requested S0ix (ACPI MS0X)
     if (pmc_s0_hack) {
@@ -213,25 +397,103 @@ static void pmc_hack(void) {
 static void pmc_hack(void) {}
 #endif
 
-void pmc_event(struct Pmc *pmc) {
-    uint8_t sts;
+bool pmc_pending(struct Pmc *pmc) {
+    uint8_t sts = pmc_status(pmc);
+    struct PmcChannel *channel = pmc_channel(pmc);
+    volatile struct HostInput *input = pmc_input(pmc);
+    // Command or data from host
+    if ((input && !host_input_empty(input)) || (sts & PMC_STS_IBF)) {
+        return true;
+    }
+    // Data for host, once it has read the last byte
+    if (channel->state == PMC_STATE_WRITE && !(sts & PMC_STS_OBF)) {
+        return true;
+    }
+    if (!channel->acpi) {
+        return false;
+    }
+    // SCI or PME pulse in progress
+    if (pmc_sci_pulse.state != PMC_PULSE_IDLE || pmc_swi_pulse.state != PMC_PULSE_IDLE) {
+        return true;
+    }
+#if PMC_S0IX_HACK
+    if (pmc_s0_hack || pmc_s0_hack2) {
+        return true;
+    }
+#endif
+    return false;
+}
 
-    pmc_hack();
+// Handle one byte of host input and write pending output. Returns true if
+// there was input.
+static bool pmc_service(struct Pmc *pmc, struct PmcChannel *channel) {
+    uint8_t sts;
+    bool input = false;
 
     // Read command/data if available
-    sts = pmc_status(pmc);
-    if (sts & PMC_STS_IBF) {
-        uint8_t data = pmc_read(pmc);
+    uint8_t data;
+    if (pmc_input_pop(pmc, &sts, &data)) {
+        input = true;
         if (sts & PMC_STS_CMD) {
-            pmc_on_input_command(pmc, data);
+            pmc_on_input_command(pmc, channel, data);
         } else {
-            pmc_on_input_data(data);
+            pmc_on_input_data(pmc, channel, data);
         }
     }
 
     // Write data if possible
     sts = pmc_status(pmc);
     if (!(sts & PMC_STS_OBF)) {
-        pmc_on_output_empty(pmc);
+        pmc_on_output_empty(pmc, channel);
+    }
+
+    return input;
+}
+
+// Longest time spent in one burst, in ticks
+#define PMC_BURST_TIMEOUT (1UL * TIME_TICKS_PER_MS)
+// Longest time to wait for the next byte in burst mode, in ticks
+#define PMC_BURST_IDLE ((400UL * TIME_TICKS_PER_MS) / 1000UL)
+
+// Service the host without returning to the main loop while burst mode is
+// enabled. If the host is too slow, burst mode is disabled and the host is
+// notified with an SCI, as allowed by the ACPI specification.
+static void pmc_burst(struct Pmc *pmc, struct PmcChannel *channel) {
+    uint32_t start = time_get_ticks();
+    uint32_t last = start;
+    while (pmc_status(pmc) & PMC_STS_BURST) {
+        pmc_pulse_update(&pmc_sci_pulse);
+
+        if (pmc_service(pmc, channel)) {
+            last = time_get_ticks();
+        }
+
+        if ((time_elapsed_ticks(start) >= PMC_BURST_TIMEOUT) ||
+            (time_elapsed_ticks(last) >= PMC_BURST_IDLE)) {
+            TRACE("pmc burst timeout\n");
+            pmc_set_status(pmc, pmc_status(pmc) & ~PMC_STS_BURST);
+            pmc_status_sci(channel);
+            break;
+        }
+    }
+}
+
+void pmc_event(struct Pmc *pmc) {
+    struct PmcChannel *channel = pmc_channel(pmc);
+
+    if (channel->acpi) {
+        pmc_hack();
+
+        pmc_pulse_update(&pmc_sci_pulse);
+        pmc_pulse_update(&pmc_swi_pulse);
+    }
+
+    pmc_service(pmc, channel);
+
+    // Only PMC1 holds the main loop in burst mode. A burst on PMC2 is served
+    // once per pass like other bytes, so it cannot delay PMC1 and the OS ACPI
+    // driver, while keeping the burst bit set for the host.
+    if (channel->acpi && (pmc_status(pmc) & PMC_STS_BURST)) {
+        pmc_burst(pmc, channel);
     }
 }
@@ -48,6 +48,10 @@ void pnp_enable() {
     pnp_write(0x07, 0x11);
     pnp_write(0x30, 0x01);
 
+    // Enable PMC2, at the default I/O ports 0x68 and 0x6C
+    pnp_write(0x07, 0x12);
+    pnp_write(0x30, 0x01);
+
     // Enable KBC keyboard
     pnp_write(0x07, 0x06);
 #if CONFIG_BUS_ESPI
@@ -17,6 +17,8 @@
 #include <board/pmc.h>
 #include <board/pnp.h>
 #include <board/ps2.h>
+#include <board/task.h>
+#include <board/telemetry.h>
 #include <board/usbpd.h>
 #include <board/wireless.h>
 #include <common/debug.h>
@@ -98,8 +100,6 @@
 #define HAVE_XLP_OUT 1
 #endif
 
-extern uint8_t main_cycle;
-
 // VccRTC stable (55%) to RTCRST# high
 #define tPCH01 delay_ms(9)
 // VccDSW stable (95%) to RSMRST# high
@@ -189,9 +189,12 @@ void update_power_state(void) {
     enum PowerState new_power_state = calculate_power_state();
     if (power_state != new_power_state) {
         power_state = new_power_state;
+        telemetry_update();
 
-        if (power_state != POWER_STATE_S0)
+        if (power_state != POWER_STATE_S0) {
             pep_hook = PEP_DISPLAY_FLAG;
+            acpi_update_power();
+        }
 
 #if LEVEL >= LEVEL_DEBUG
         switch (power_state) {
@@ -530,12 +533,15 @@ void power_event(void) {
         power_apply_limit(!ac_new);
         battery_debug();
 
-        // Reset main loop cycle to force reading PECI and battery
-        main_cycle = 0;
+        // Force reading PECI and battery
+        task_trigger(TASK_FAN);
+        task_trigger(TASK_BATTERY);
 
         // Send SCI to update AC and battery information
         ac_send_sci = true;
+        acpi_update_power();
     }
+
     if (ac_send_sci) {
         // Send SCI 0x16 for AC detect event if ACPI OS is loaded
         if (acpi_ecos != EC_OS_NONE) {
@@ -564,7 +570,7 @@ void power_event(void) {
         for (uint8_t i = 100; i != 0; i--) {
             delay_ms(1);
             if (gpio_get(&PWR_SW_N) != ps_new) {
-                DEBUG("%02X: Spurious press\n", main_cycle);
+                DEBUG("Spurious press\n");
                 ps_new = ps_last;
                 break;
             } else if (power_button_disabled()) {
@@ -575,7 +581,7 @@ void power_event(void) {
         }
 
         if (ps_new != ps_last) {
-            DEBUG("%02X: Power switch press\n", main_cycle);
+            DEBUG("Power switch press\n");
 
             // Enable S5 power if necessary, before sending PWR_BTN
             if (power_state >= POWER_STATE_G3_AOU) {
@@ -590,7 +596,7 @@ void power_event(void) {
     }
 #if LEVEL >= LEVEL_DEBUG
     else if (ps_new && !ps_last) {
-        DEBUG("%02X: Power switch release\n", main_cycle);
+        DEBUG("Power switch release\n");
     }
 #endif
     ps_last = ps_new;
@@ -605,7 +611,7 @@ void power_event(void) {
     static bool pg_last = false;
     bool pg_new = gpio_get(&ALL_SYS_PWRGD);
     if (pg_new && !pg_last) {
-        DEBUG("%02X: ALL_SYS_PWRGD asserted\n", main_cycle);
+        DEBUG("ALL_SYS_PWRGD asserted\n");
 
         //TODO: tPLT04;
 
@@ -622,7 +628,7 @@ void power_event(void) {
         GPIO_SET_DEBUG(PCH_PWROK_EC, true);
 #endif // HAVE_PCH_PWROK_EC
     } else if (!pg_new && pg_last) {
-        DEBUG("%02X: ALL_SYS_PWRGD de-asserted\n", main_cycle);
+        DEBUG("ALL_SYS_PWRGD de-asserted\n");
 
 #if HAVE_PCH_PWROK_EC
         // De-assert SYS_PWROK
@@ -641,11 +647,11 @@ void power_event(void) {
     bool rst_new = gpio_get(&BUF_PLT_RST_N);
 #if LEVEL >= LEVEL_DEBUG
     if (!rst_new && rst_last) {
-        DEBUG("%02X: PLT_RST# asserted\n", main_cycle);
+        DEBUG("PLT_RST# asserted\n");
     } else
 #endif
     if (rst_new && !rst_last) {
-        DEBUG("%02X: PLT_RST# de-asserted\n", main_cycle);
+        DEBUG("PLT_RST# de-asserted\n");
 #if CONFIG_BUS_ESPI
         espi_reset();
 #else // CONFIG_BUS_ESPI
@@ -660,9 +666,9 @@ void power_event(void) {
     static bool sus_last = true;
     bool sus_new = gpio_get(&SLP_SUS_N);
     if (!sus_new && sus_last) {
-        DEBUG("%02X: SLP_SUS# asserted\n", main_cycle);
+        DEBUG("SLP_SUS# asserted\n");
     } else if (sus_new && !sus_last) {
-        DEBUG("%02X: SLP_SUS# de-asserted\n", main_cycle);
+        DEBUG("SLP_SUS# de-asserted\n");
     }
     sus_last = sus_new;
 #endif
@@ -678,9 +684,9 @@ void power_event(void) {
     bool ack_new = gpio_get(&SUSWARN_N);
 #if LEVEL >= LEVEL_DEBUG
     if (ack_new && !ack_last) {
-        DEBUG("%02X: SUSPWRDNACK asserted\n", main_cycle);
+        DEBUG("SUSPWRDNACK asserted\n");
     } else if (!ack_new && ack_last) {
-        DEBUG("%02X: SUSPWRDNACK de-asserted\n", main_cycle);
+        DEBUG("SUSPWRDNACK de-asserted\n");
     }
 #endif
     ack_last = ack_new;
@@ -706,14 +712,14 @@ void power_event(void) {
     bool wake_new = gpio_get(&LAN_WAKEUP_N);
     if (!wake_new && wake_last) {
         update_power_state();
-        DEBUG("%02X: LAN_WAKEUP# asserted\n", main_cycle);
+        DEBUG("LAN_WAKEUP# asserted\n");
         if (power_state == POWER_STATE_G3) {
             power_on();
         }
     }
 #if LEVEL >= LEVEL_DEBUG
     else if (wake_new && !wake_last) {
-        DEBUG("%02X: LAN_WAKEUP# de-asserted\n", main_cycle);
+        DEBUG("LAN_WAKEUP# de-asserted\n");
     }
 #endif
     wake_last = wake_new;
@@ -18,11 +18,16 @@
 #include <string.h>
 
 #if !defined(__SCRATCH__)
+#include <arch/time.h>
 #include <board/scratch.h>
+#include <board/idle.h>
+#include <board/kbc.h>
+#include <board/pmc.h>
 #include <board/kbled.h>
 #include <board/kbscan.h>
 #include <board/peci.h>
 #include <board/dgpu.h>
+#include <board/task.h>
 #include <board/fan.h>
 #include <board/wireless.h>
 #include <common/debug.h>
@@ -78,9 +83,56 @@ volatile uint8_t __xdata __at(0x103F) ECINDDR;
 #define SMFI_CMD_DATA 0x02
 static volatile uint8_t __xdata __at(0xE00) smfi_cmd[256];
 
-// Debug region - ring buffer of EC firmware prints
-#define SMFI_DBG_TAIL 0x00
-static volatile uint8_t __xdata __at(0xF00) smfi_dbg[256];
+// Size of the debug region, which sets the access allow size of H2RAM window
+// 1. It cannot be larger than 256 bytes, as registers start at 0x1000.
+#ifndef SMFI_DBG_SIZE
+#define SMFI_DBG_SIZE 256
+#endif
+
+#if SMFI_DBG_SIZE == 32
+#define SMFI_DBG_AAS 0x01
+#elif SMFI_DBG_SIZE == 64
+#define SMFI_DBG_AAS 0x02
+#elif SMFI_DBG_SIZE == 128
+#define SMFI_DBG_AAS 0x03
+#elif SMFI_DBG_SIZE == 256
+#define SMFI_DBG_AAS 0x04
+#else
+#error "SMFI_DBG_SIZE must be 32, 64, 128, or 256"
+#endif
+
+// Debug region - ring buffer of EC firmware prints, after a header. The host
+// finds new bytes by comparing the sequence with the one it last read. If
+// they differ by more than the size of the ring, bytes were overwritten.
+#define SMFI_DBG_SIGNATURE_0 0x76
+#define SMFI_DBG_SIGNATURE_1 0xEC
+#define SMFI_DBG_HEADER_SIZE 16
+struct SmfiDebug {
+    // Identifies this layout, the first byte used to be the tail
+    uint8_t signature[2];
+    // Size of data
+    uint8_t size;
+    // Offset in data of the next byte to write
+    uint8_t tail;
+    // Number of bytes written, updated after each byte
+    uint32_t sequence;
+    // Number of bytes dropped, as the ring was already being written
+    uint16_t dropped;
+    // Set while a byte is being written
+    uint8_t busy;
+    uint8_t reserved[5];
+    uint8_t data[SMFI_DBG_SIZE - SMFI_DBG_HEADER_SIZE];
+};
+static volatile struct SmfiDebug __xdata __at(0xF00) smfi_dbg;
+
+#if !defined(__SCRATCH__)
+// Batch region - copy of the batched records while their commands run, not
+// mapped to the host. On IT8587E, this is in the SRAM scratch ROM is loaded
+// to. Scratch ROM is only entered by the commands of SMFI_COMMANDS_SCRATCH,
+// which smfi_command_batch does not run, so it is never entered while the
+// region is in use.
+static volatile uint8_t __xdata __at(0xB00) smfi_batch[256];
+#endif // !defined(__SCRATCH__)
 
 #if !defined(__SCRATCH__)
 void smfi_init(void) {
@@ -94,22 +146,40 @@ void smfi_init(void) {
     smfi_cmd[SMFI_CMD_CMD] = 0x00;
 
     // Clear debug region
-    for (i = (SMFI_DBG_TAIL + 1); i < ARRAY_SIZE(smfi_dbg); i++) {
-        smfi_dbg[i] = 0x00;
+    for (i = 0; i < ARRAY_SIZE(smfi_dbg.data); i++) {
+        smfi_dbg.data[i] = 0x00;
     }
-    // Clear tail last
-    smfi_dbg[SMFI_DBG_TAIL] = 0x00;
+    smfi_dbg.size = (uint8_t)ARRAY_SIZE(smfi_dbg.data);
+    smfi_dbg.tail = 0;
+    smfi_dbg.sequence = 0;
+    smfi_dbg.dropped = 0;
+    smfi_dbg.busy = 0;
+    // Set signature last
+    smfi_dbg.signature[0] = SMFI_DBG_SIGNATURE_0;
+    smfi_dbg.signature[1] = SMFI_DBG_SIGNATURE_1;
 
     // H2RAM window 0 address 0xE00 - 0xEFF, read/write
     HRAMW0BA = 0xE0;
     HRAMW0AAS = 0x04;
 
-    // H2RAM window 1 address 0xF00 - 0xFFF, read-only
+    // H2RAM window 1 address 0xF00 - 0xFFF, read-only, size of debug region
     HRAMW1BA = 0xF0;
-    HRAMW1AAS = 0x34;
+    HRAMW1AAS = 0x30 | SMFI_DBG_AAS;
+
+    // H2RAM window 2 address 0xD00 - 0xDFF, read-only, ACPI space shadow. The
+    // host must decode these ports to the EC, see doc/debugging.md
+    HRAMW2BA = 0xD0;
+    HRAMW2AAS = 0x34;
 
-    // Enable H2RAM window 0 and 1 using LPC I/O
-    HRAMWC |= BIT(4) | BIT(1) | BIT(0);
+    // H2RAM window 3 address 0xC00 - 0xC1F, read-only, telemetry. This is
+    // kept to 32 bytes to stay clear of the PCI configuration and reset ports
+    // at 0xCF8 - 0xCFF. The host must decode these ports to the EC, see
+    // doc/debugging.md
+    HRAMW3BA = 0xC0;
+    HRAMW3AAS = 0x31;
+
+    // Enable H2RAM window 0, 1, 2, and 3 using LPC I/O
+    HRAMWC |= BIT(4) | BIT(3) | BIT(2) | BIT(1) | BIT(0);
 
     // Enable backup ROM access
     FLHCTRL3 |= BIT(3);
@@ -213,6 +283,35 @@ static enum Result cmd_matrix_get(void) {
     return RES_OK;
 }
 
+// Command structure: [action] [calibrating] [rows] [release] [settle]... [calibration]...
+// Times are in timer ticks
+static enum Result cmd_matrix_calibrate(void) {
+    switch (smfi_cmd[SMFI_CMD_DATA]) {
+    case CMD_MATRIX_CALIBRATE_GET:
+        break;
+    case CMD_MATRIX_CALIBRATE_START:
+        kbscan_calibrate_start();
+        break;
+    case CMD_MATRIX_CALIBRATE_APPLY:
+        kbscan_calibrate_stop(true);
+        break;
+    case CMD_MATRIX_CALIBRATE_CANCEL:
+        kbscan_calibrate_stop(false);
+        break;
+    default:
+        return RES_ERR;
+    }
+
+    smfi_cmd[SMFI_CMD_DATA + 1] = kbscan_calibrating;
+    smfi_cmd[SMFI_CMD_DATA + 2] = KM_OUT;
+    smfi_cmd[SMFI_CMD_DATA + 3] = kbscan_release;
+    for (uint8_t row = 0; row < KM_OUT; row++) {
+        smfi_cmd[SMFI_CMD_DATA + 4 + row] = kbscan_settle[row];
+        smfi_cmd[SMFI_CMD_DATA + 4 + KM_OUT + row] = kbscan_calibration[row];
+    }
+    return RES_OK;
+}
+
 #if CONFIG_SECURITY
 static enum Result cmd_security_get(void) {
     smfi_cmd[SMFI_CMD_DATA] = security_get();
@@ -278,6 +377,66 @@ static enum Result cmd_option_set(void) {
     return !options_set(smfi_cmd[SMFI_CMD_DATA], smfi_cmd[SMFI_CMD_DATA + 1]);
 }
 
+static void cmd_put_u32(uint8_t offset, uint32_t value) {
+    smfi_cmd[offset] = (uint8_t)value;
+    smfi_cmd[offset + 1] = (uint8_t)(value >> 8);
+    smfi_cmd[offset + 2] = (uint8_t)(value >> 16);
+    smfi_cmd[offset + 3] = (uint8_t)(value >> 24);
+}
+
+// Command structure: [task] [count] [last] [min] [max] [avg] [runs] [active] [name]
+// Times are in microseconds
+static enum Result cmd_profile_get(void) {
+    uint8_t id = smfi_cmd[SMFI_CMD_DATA];
+    if (id >= TASK_COUNT) {
+        return RES_ERR;
+    }
+
+    struct TaskProfile *profile = &task_profile[id];
+    smfi_cmd[SMFI_CMD_DATA + 1] = TASK_COUNT;
+    cmd_put_u32(SMFI_CMD_DATA + 2, time_ticks_to_us(profile->last));
+    cmd_put_u32(SMFI_CMD_DATA + 6, time_ticks_to_us(profile->min));
+    cmd_put_u32(SMFI_CMD_DATA + 10, time_ticks_to_us(profile->max));
+    cmd_put_u32(SMFI_CMD_DATA + 14, time_ticks_to_us(profile->avg));
+    smfi_cmd[SMFI_CMD_DATA + 18] = (uint8_t)profile->runs;
+    smfi_cmd[SMFI_CMD_DATA + 19] = (uint8_t)(profile->runs >> 8);
+    smfi_cmd[SMFI_CMD_DATA + 20] = idle_active;
+    strncpy(&smfi_cmd[SMFI_CMD_DATA + 21], task_name(id), ARRAY_SIZE(smfi_cmd) - (SMFI_CMD_DATA + 21));
+
+    return RES_OK;
+}
+
+// Command structure: [clear] [buckets] [base] [max] [histogram]... [overflow]
+// Times are in microseconds, the histogram is cleared after reading if clear is set
+static enum Result cmd_latency_get(void) {
+    smfi_cmd[SMFI_CMD_DATA + 1] = KBC_LATENCY_BUCKETS;
+    smfi_cmd[SMFI_CMD_DATA + 2] = (uint8_t)KBC_LATENCY_BASE;
+    smfi_cmd[SMFI_CMD_DATA + 3] = (uint8_t)(KBC_LATENCY_BASE >> 8);
+    cmd_put_u32(SMFI_CMD_DATA + 4, kbc_latency.max);
+    for (uint8_t i = 0; i < KBC_LATENCY_BUCKETS; i++) {
+        smfi_cmd[SMFI_CMD_DATA + 8 + 2 * i] = (uint8_t)kbc_latency.histogram[i];
+        smfi_cmd[SMFI_CMD_DATA + 9 + 2 * i] = (uint8_t)(kbc_latency.histogram[i] >> 8);
+    }
+    smfi_cmd[SMFI_CMD_DATA + 8 + 2 * KBC_LATENCY_BUCKETS] = (uint8_t)kbc_buffer_overflow;
+    smfi_cmd[SMFI_CMD_DATA + 9 + 2 * KBC_LATENCY_BUCKETS] = (uint8_t)(kbc_buffer_overflow >> 8);
+
+    if (smfi_cmd[SMFI_CMD_DATA]) {
+        kbc_latency_reset();
+        kbc_buffer_overflow = 0;
+    }
+    return RES_OK;
+}
+
+// Command structure: [reads] [writes] [queries] [sci] [swi]
+static enum Result cmd_acpi_stats(void) {
+    cmd_put_u32(SMFI_CMD_DATA, pmc_stats.reads);
+    cmd_put_u32(SMFI_CMD_DATA + 4, pmc_stats.writes);
+    cmd_put_u32(SMFI_CMD_DATA + 8, pmc_stats.queries);
+    cmd_put_u32(SMFI_CMD_DATA + 12, pmc_stats.sci);
+    cmd_put_u32(SMFI_CMD_DATA + 16, pmc_stats.swi);
+    return RES_OK;
+}
+
 #endif // !defined(__SCRATCH__)
 
 #if defined(__SCRATCH__)
@@ -366,101 +525,229 @@ void smfi_watchdog(void) {
     EWDCNTLHR = 0x04;
 }
 
-void smfi_event(void) {
-    if (smfi_cmd[SMFI_CMD_CMD]) {
-#if defined(__SCRATCH__)
-        // If in scratch ROM, restart watchdog timer when command received
-        smfi_watchdog();
-#endif
-
-        switch (smfi_cmd[SMFI_CMD_CMD]) {
 #if !defined(__SCRATCH__)
-        case CMD_PROBE:
-            // Signature
-            smfi_cmd[SMFI_CMD_DATA + 0] = 0x76;
-            smfi_cmd[SMFI_CMD_DATA + 1] = 0xEC;
-            // Version
-            smfi_cmd[SMFI_CMD_DATA + 2] = 0x01;
-            //TODO: bitmask of implemented commands?
-            // Always successful
-            smfi_cmd[SMFI_CMD_RES] = RES_OK;
-            break;
-        case CMD_BOARD:
-            strncpy(&smfi_cmd[SMFI_CMD_DATA], board(), ARRAY_SIZE(smfi_cmd) - SMFI_CMD_DATA);
-            // Always successful
-            smfi_cmd[SMFI_CMD_RES] = RES_OK;
-            break;
-        case CMD_VERSION:
-            strncpy(&smfi_cmd[SMFI_CMD_DATA], version(), ARRAY_SIZE(smfi_cmd) - SMFI_CMD_DATA);
-            // Always successful
-            smfi_cmd[SMFI_CMD_RES] = RES_OK;
-            break;
-        case CMD_PRINT:
-            smfi_cmd[SMFI_CMD_RES] = cmd_print();
-            break;
-        case CMD_FAN_GET:
-            smfi_cmd[SMFI_CMD_RES] = cmd_fan_get();
-            break;
-        case CMD_FAN_SET:
-            smfi_cmd[SMFI_CMD_RES] = cmd_fan_set();
-            break;
-        case CMD_KEYMAP_GET:
-            smfi_cmd[SMFI_CMD_RES] = cmd_keymap_get();
-            break;
-        case CMD_KEYMAP_SET:
-            smfi_cmd[SMFI_CMD_RES] = cmd_keymap_set();
-            break;
-        case CMD_MATRIX_GET:
-            smfi_cmd[SMFI_CMD_RES] = cmd_matrix_get();
-            break;
-        case CMD_FAN_CURVE_SET:
-            smfi_cmd[SMFI_CMD_RES] = cmd_fan_curve_set();
-            break;
-        case CMD_CAMERA_ENABLEMENT_SET:
-            smfi_cmd[SMFI_CMD_RES] = cmd_camera_enablement_set();
-            break;
-        case CMD_WIFI_BT_ENABLEMENT_SET:
-            smfi_cmd[SMFI_CMD_RES] = cmd_wifi_bt_enablement_set();
-            break;
-        case CMD_OPTION_GET:
-            smfi_cmd[SMFI_CMD_RES] = cmd_option_get();
-            break;
-        case CMD_OPTION_SET:
-            smfi_cmd[SMFI_CMD_RES] = cmd_option_set();
-            break;
+bool smfi_pending(void) {
+    return smfi_cmd[SMFI_CMD_CMD] != CMD_NONE;
+}
+
+static enum Result cmd_board(void) {
+    strncpy(&smfi_cmd[SMFI_CMD_DATA], board(), ARRAY_SIZE(smfi_cmd) - SMFI_CMD_DATA);
+    // Always successful
+    return RES_OK;
+}
+
+static enum Result cmd_version(void) {
+    strncpy(&smfi_cmd[SMFI_CMD_DATA], version(), ARRAY_SIZE(smfi_cmd) - SMFI_CMD_DATA);
+    // Always successful
+    return RES_OK;
+}
+#endif // !defined(__SCRATCH__)
+
+// Commands run by smfi_command, as X(command, handler). Both the switch of
+// smfi_command and the list reported by CMD_PROBE are generated from these,
+// so a command cannot be added to one and not the other.
 #if CONFIG_SECURITY
-        case CMD_SECURITY_GET:
-            smfi_cmd[SMFI_CMD_RES] = cmd_security_get();
-            break;
-        case CMD_SECURITY_SET:
-            smfi_cmd[SMFI_CMD_RES] = cmd_security_set();
-            break;
+#define SMFI_COMMANDS_SECURITY(X)                                              \
+    X(CMD_SECURITY_GET, cmd_security_get)                                      \
+    X(CMD_SECURITY_SET, cmd_security_set)
+#else // CONFIG_SECURITY
+#define SMFI_COMMANDS_SECURITY(X)
 #endif // CONFIG_SECURITY
 
+#define SMFI_COMMANDS(X)                                                       \
+    X(CMD_PROBE, cmd_probe)                                                    \
+    X(CMD_BOARD, cmd_board)                                                    \
+    X(CMD_VERSION, cmd_version)                                                \
+    X(CMD_PRINT, cmd_print)                                                    \
+    X(CMD_FAN_GET, cmd_fan_get)                                                \
+    X(CMD_FAN_SET, cmd_fan_set)                                                \
+    X(CMD_KEYMAP_GET, cmd_keymap_get)                                          \
+    X(CMD_KEYMAP_SET, cmd_keymap_set)                                          \
+    X(CMD_MATRIX_GET, cmd_matrix_get)                                          \
+    X(CMD_MATRIX_CALIBRATE, cmd_matrix_calibrate)                              \
+    X(CMD_FAN_CURVE_SET, cmd_fan_curve_set)                                    \
+    X(CMD_CAMERA_ENABLEMENT_SET, cmd_camera_enablement_set)                    \
+    X(CMD_WIFI_BT_ENABLEMENT_SET, cmd_wifi_bt_enablement_set)                  \
+    X(CMD_OPTION_GET, cmd_option_get)                                          \
+    X(CMD_OPTION_SET, cmd_option_set)                                          \
+    X(CMD_PROFILE_GET, cmd_profile_get)                                        \
+    X(CMD_LATENCY_GET, cmd_latency_get)                                        \
+    X(CMD_ACPI_STATS, cmd_acpi_stats)                                          \
+    SMFI_COMMANDS_SECURITY(X)
+
+// Commands that are also run from scratch ROM
+#define SMFI_COMMANDS_SCRATCH(X)                                               \
+    X(CMD_SPI, cmd_spi)                                                        \
+    X(CMD_RESET, cmd_reset)
+
+#define SMFI_COMMAND_ID(command, handler) command,
+#define SMFI_COMMAND_CASE(command, handler)                                    \
+    case command:                                                              \
+        return handler();
+
+#if !defined(__SCRATCH__)
+// Commands reported by CMD_PROBE. CMD_BATCH is run by smfi_event instead.
+static const uint8_t __code smfi_commands[] = {
+    SMFI_COMMANDS(SMFI_COMMAND_ID)
+    SMFI_COMMANDS_SCRATCH(SMFI_COMMAND_ID)
+    CMD_BATCH,
+};
+
+// Size of the command bitmap, in bytes
+#define SMFI_PROBE_COMMANDS 8
+
+// Command structure: [signature] [signature] [version] [data size]
+// [bitmap size] [bitmap]... [features]
+// Bit N of the bitmap is set if command N is implemented, and features are
+// CMD_PROBE_FEATURE_* flags. Older firmware leaves everything after the
+// version untouched.
+static enum Result cmd_probe(void) {
+    // Signature
+    smfi_cmd[SMFI_CMD_DATA + 0] = 0x76;
+    smfi_cmd[SMFI_CMD_DATA + 1] = 0xEC;
+    // Version
+    smfi_cmd[SMFI_CMD_DATA + 2] = 0x01;
+    // Size of the data region
+    smfi_cmd[SMFI_CMD_DATA + 3] = ARRAY_SIZE(smfi_cmd) - SMFI_CMD_DATA;
+
+    smfi_cmd[SMFI_CMD_DATA + 4] = SMFI_PROBE_COMMANDS;
+    for (uint8_t i = 0; i < SMFI_PROBE_COMMANDS; i++) {
+        smfi_cmd[SMFI_CMD_DATA + 5 + i] = 0;
+    }
+    for (uint8_t i = 0; i < ARRAY_SIZE(smfi_commands); i++) {
+        uint8_t cmd = smfi_commands[i];
+        smfi_cmd[SMFI_CMD_DATA + 5 + (cmd >> 3)] |= BIT(cmd & 7);
+    }
+    smfi_cmd[SMFI_CMD_DATA + 5 + SMFI_PROBE_COMMANDS] = CMD_PROBE_FEATURE_TELEMETRY;
+
+    // Always successful
+    return RES_OK;
+}
 #endif // !defined(__SCRATCH__)
-        case CMD_SPI:
-            smfi_cmd[SMFI_CMD_RES] = cmd_spi();
-            break;
-        case CMD_RESET:
-            smfi_cmd[SMFI_CMD_RES] = cmd_reset();
+
+#if !defined(__SCRATCH__)
+// Run a command that can be batched. Commands that do not return, or that
+// enter scratch ROM and so overwrite smfi_batch, are not in SMFI_COMMANDS.
+static enum Result smfi_command_batch(uint8_t cmd) {
+    switch (cmd) {
+    SMFI_COMMANDS(SMFI_COMMAND_CASE)
+    }
+
+    // Command not found
+    return RES_ERR;
+}
+#endif // !defined(__SCRATCH__)
+
+static enum Result smfi_command(uint8_t cmd) {
+    switch (cmd) {
+    SMFI_COMMANDS_SCRATCH(SMFI_COMMAND_CASE)
+    }
+
+#if !defined(__SCRATCH__)
+    return smfi_command_batch(cmd);
+#else // !defined(__SCRATCH__)
+    // Command not found
+    return RES_ERR;
+#endif // !defined(__SCRATCH__)
+}
+
+#if !defined(__SCRATCH__)
+// Command structure: [count] ([command] [length] [data]...)...
+// Response structure: [count run] ([result] [length] [data]...)...
+// Each command is run with its data at the start of the data region, and its
+// data is replaced with the same number of bytes of its response. Commands
+// that do not return, or run from scratch ROM, cannot be batched.
+static enum Result cmd_batch(void) {
+    uint8_t count = smfi_cmd[SMFI_CMD_DATA];
+    uint16_t size = ARRAY_SIZE(smfi_cmd) - SMFI_CMD_DATA;
+    uint16_t offset = 1;
+    uint8_t run;
+    uint16_t i;
+
+    for (i = 0; i < size; i++) {
+        smfi_batch[i] = smfi_cmd[SMFI_CMD_DATA + i];
+    }
+
+    for (run = 0; run < count; run++) {
+        if ((offset + 2) > size) {
             break;
-        default:
-            // Command not found
-            smfi_cmd[SMFI_CMD_RES] = RES_ERR;
+        }
+        uint8_t cmd = smfi_batch[offset];
+        uint8_t len = smfi_batch[offset + 1];
+        uint16_t start = offset + 2;
+        if ((start + len) > size) {
             break;
         }
 
+        for (i = 0; i < len; i++) {
+            smfi_cmd[SMFI_CMD_DATA + i] = smfi_batch[start + i];
+        }
+
+        smfi_batch[offset] = smfi_command_batch(cmd);
+
+        for (i = 0; i < len; i++) {
+            smfi_batch[start + i] = smfi_cmd[SMFI_CMD_DATA + i];
+        }
+
+        offset = start + len;
+    }
+
+    for (i = 0; i < size; i++) {
+        smfi_cmd[SMFI_CMD_DATA + i] = smfi_batch[i];
+    }
+    smfi_cmd[SMFI_CMD_DATA] = run;
+
+    // Failed if any record did not fit
+    return (run == count) ? RES_OK : RES_ERR;
+}
+#endif // !defined(__SCRATCH__)
+
+void smfi_event(void) {
+    uint8_t cmd = smfi_cmd[SMFI_CMD_CMD];
+    if (cmd) {
+#if defined(__SCRATCH__)
+        // If in scratch ROM, restart watchdog timer when command received
+        smfi_watchdog();
+#endif
+
+#if defined(__SCRATCH__)
+        smfi_cmd[SMFI_CMD_RES] = smfi_command(cmd);
+#else // defined(__SCRATCH__)
+        // Batches are run here, so commands are never nested
+        if (cmd == CMD_BATCH) {
+            smfi_cmd[SMFI_CMD_RES] = cmd_batch();
+        } else {
+            smfi_cmd[SMFI_CMD_RES] = smfi_command(cmd);
+        }
+#endif // defined(__SCRATCH__)
+
         // Mark command as finished
         smfi_cmd[SMFI_CMD_CMD] = CMD_NONE;
     }
 }
 
 void smfi_debug(uint8_t byte) {
-    int16_t tail = (int16_t)smfi_dbg[SMFI_DBG_TAIL];
+    if (smfi_dbg.busy) {
+        // Printing from an interrupt would corrupt the ring
+        if (smfi_dbg.dropped < 0xFFFF) {
+            smfi_dbg.dropped++;
+        }
+        return;
+    }
+    smfi_dbg.busy = 1;
+
+    // Tail is not valid before smfi_init
+    uint8_t tail = smfi_dbg.tail;
+    if (tail >= ARRAY_SIZE(smfi_dbg.data)) {
+        tail = 0;
+    }
+    smfi_dbg.data[tail] = byte;
     tail++;
-    if (tail >= ARRAY_SIZE(smfi_dbg)) {
-        tail = SMFI_DBG_TAIL + 1;
+    if (tail >= ARRAY_SIZE(smfi_dbg.data)) {
+        tail = 0;
     }
-    smfi_dbg[tail] = byte;
-    smfi_dbg[SMFI_DBG_TAIL] = (uint8_t)tail;
+    smfi_dbg.tail = tail;
+    smfi_dbg.sequence++;
+
+    smfi_dbg.busy = 0;
 }
@@ -0,0 +1,181 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Deadline-driven scheduler for the main loop. Each task becomes due when its
+// period has elapsed since it last ran. Of all due tasks, the one with the
+// least time left before its deadline is run. Tasks with a period of 0 are
+// due whenever they have pending work, and share the remaining time
+// round-robin. If no task is due, the main loop can idle.
+//
+// The execution time of every run is recorded in task_profile.
+
+#include <stddef.h>
+
+#include <arch/time.h>
+#include <board/acpi.h>
+#include <board/battery.h>
+#include <board/board.h>
+#include <board/dgpu.h>
+#include <board/fan.h>
+#include <board/kbc.h>
+#include <board/kbscan.h>
+#include <board/lid.h>
+#include <board/peci.h>
+#include <board/pmc.h>
+#include <board/power.h>
+#include <board/smfi.h>
+#include <board/task.h>
+#include <board/telemetry.h>
+#include <board/usbpd.h>
+#include <common/macro.h>
+
+#ifdef PARALLEL_DEBUG
+#include <board/parallel.h>
+#endif // PARALLEL_DEBUG
+
+// update fan speed more frequently for smoother fans
+#define FAN_INTERVAL (SMOOTH_FANS != 0 ? 250 : 1000)
+#define BATTERY_INTERVAL 1000
+
+static void task_kbscan(void) {
+#if PARALLEL_DEBUG
+    if (!parallel_debug)
+#endif // PARALLEL_DEBUG
+    {
+        // Scans keyboard and sends keyboard packets
+        kbscan_event();
+    }
+}
+
+static bool task_kbscan_pending(void) {
+#if PARALLEL_DEBUG
+    if (parallel_debug) {
+        return false;
+    }
+#endif // PARALLEL_DEBUG
+    return kbscan_pending();
+}
+
+static void task_kbc(void) {
+    // Checks for keyboard/mouse packets from host
+    kbc_event(&KBC);
+}
+
+static void task_pmc(void) {
+    // Handles ACPI communication
+    pmc_event(&PMC_1);
+}
+
+static void task_pmc2(void) {
+    // Handles communication with tools and drivers
+    pmc_event(&PMC_2);
+}
+
+static bool task_kbc_pending(void) {
+    return kbc_pending(&KBC);
+}
+
+static bool task_pmc_pending(void) {
+    return pmc_pending(&PMC_1);
+}
+
+static bool task_pmc2_pending(void) {
+    return pmc_pending(&PMC_2);
+}
+
+static void task_power(void) {
+    // Handle USB-C events immediately before power states
+    usbpd_event();
+
+    // Handle power states
+    power_event();
+}
+
+static void task_fan(void) {
+    // Update fan speeds
+    fan_duty_set(peci_get_fan_duty(), dgpu_get_fan_duty());
+
+    // Report new temperatures and fan speeds
+    acpi_update_fan();
+    telemetry_update();
+}
+
+// clang-format off
+static const struct Task __code tasks[TASK_COUNT] = {
+    // TASK_KBSCAN
+    { "kbscan", task_kbscan, task_kbscan_pending, 1, 1 },
+    // TASK_KBC
+    { "kbc", task_kbc, task_kbc_pending, 0, 2 },
+    // TASK_PMC
+    { "pmc", task_pmc, task_pmc_pending, 0, 2 },
+    // TASK_PMC2: Host interface for tools and drivers
+    { "pmc2", task_pmc2, task_pmc2_pending, 0, 2 },
+    // TASK_SMFI: AP/EC communication over SMFI
+    { "smfi", smfi_event, smfi_pending, 0, 2 },
+    // TASK_POWER
+    { "power", task_power, NULL, 1, 4 },
+    // TASK_LID: Handle lid close/open
+    { "lid", lid_event, NULL, 10, 10 },
+    // TASK_BOARD: Board-specific events
+    { "board", board_event, NULL, 1, 2 },
+    // TASK_FAN
+    { "fan", task_fan, NULL, FAN_INTERVAL, 10 },
+    // TASK_BATTERY: Updates battery status
+    { "battery", battery_event, NULL, BATTERY_INTERVAL, 10 },
+};
+// clang-format on
+
+struct TaskProfile task_profile[TASK_COUNT] = { 0 };
+
+// Time each task was last run
+static uint32_t task_last[TASK_COUNT] = { 0 };
+// Tasks that must run as soon as possible
+static uint16_t task_triggered = 0;
+// Last task that was run, used to break ties
+static uint8_t task_current = TASK_COUNT - 1;
+
+static void task_profile_update(struct TaskProfile *profile, uint32_t ticks) {
+    profile->last = ticks;
+    if (profile->runs == 0) {
+        profile->min = ticks;
+        profile->max = ticks;
+        profile->avg = ticks;
+    } else {
+        if (ticks < profile->min) {
+            profile->min = ticks;
+        }
+        if (ticks > profile->max) {
+            profile->max = ticks;
+        }
+        profile->avg = profile->avg - (profile->avg >> 3) + (ticks >> 3);
+    }
+    if (profile->runs < 0xFFFF) {
+        profile->runs++;
+    }
+}
+
+const char *task_name(enum TaskId id) {
+    return tasks[id].name;
+}
+
+bool task_run(void) {
+    uint32_t time = time_get();
+
+    uint8_t next = task_select(tasks, task_last, TASK_COUNT, task_triggered, task_current, time);
+    if (next == TASK_COUNT) {
+        return false;
+    }
+
+    task_triggered &= ~BIT(next);
+    task_last[next] = time;
+    task_current = next;
+
+    uint32_t start = time_get_ticks();
+    tasks[next].run();
+    task_profile_update(&task_profile[next], time_elapsed_ticks(start));
+
+    return true;
+}
+
+void task_trigger(enum TaskId id) {
+    task_triggered |= BIT(id);
+}
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Task selection of the scheduler: picks the task to run next from the
+// periods, deadlines, and pending work of the tasks.
+
+#include <board/task.h>
+
+uint8_t task_select(
+    const struct Task *tasks,
+    const uint32_t *last,
+    uint8_t count,
+    uint16_t triggered,
+    uint8_t current,
+    uint32_t time
+) {
+    uint8_t next = count;
+    int32_t next_slack = 0;
+
+    // Start after the last task run, so tasks with equal slack take turns
+    uint8_t id = current;
+    for (uint8_t i = 0; i < count; i++) {
+        id++;
+        if (id >= count) {
+            id = 0;
+        }
+
+        int32_t slack;
+        if (triggered & (1U << id)) {
+            slack = (int32_t)tasks[id].deadline;
+        } else {
+            uint32_t elapsed = time - last[id];
+            if (elapsed < tasks[id].period) {
+                // Not due yet
+                continue;
+            }
+            if (tasks[id].pending && !tasks[id].pending()) {
+                // Nothing to do
+                continue;
+            }
+            slack = (int32_t)((uint32_t)tasks[id].period + tasks[id].deadline - elapsed);
+        }
+
+        if (next == count || slack < next_slack) {
+            next = id;
+            next_slack = slack;
+        }
+    }
+
+    return next;
+}
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <arch/time.h>
+#include <board/battery.h>
+#include <board/dgpu.h>
+#include <board/gpio.h>
+#include <board/peci.h>
+#include <board/power.h>
+#include <board/telemetry.h>
+#include <common/macro.h>
+#include <ec/pwm.h>
+
+// Below the ACPI space shadow, outside of the zeroed data segment
+static volatile struct Telemetry __xdata __at(0xC00) telemetry;
+
+_Static_assert(
+    sizeof(struct Telemetry) <= TELEMETRY_SIZE,
+    "struct Telemetry does not fit in its page"
+);
+
+void telemetry_init(void) {
+    telemetry.version = TELEMETRY_VERSION;
+    telemetry.sequence = 0;
+    telemetry_update();
+}
+
+void telemetry_update(void) {
+    // Mark the fields as being written
+    telemetry.sequence++;
+
+    telemetry.time = time_get();
+    telemetry.power_state = (uint8_t)power_state;
+
+    uint8_t flags = 0;
+    if (!gpio_get(&ACIN_N)) {
+        flags |= TELEMETRY_FLAG_AC;
+    }
+    if (gpio_get(&LID_SW_N)) {
+        flags |= TELEMETRY_FLAG_LID;
+    }
+    telemetry.flags = flags;
+
+    telemetry.cpu_temp = peci_temp;
+#if HAVE_DGPU
+    telemetry.dgpu_temp = dgpu_temp;
+#else
+    telemetry.dgpu_temp = 0;
+#endif
+
+    telemetry.fan_duty[0] = PWM_REG(CPU_FAN1);
+    telemetry.fan_tach[0] = ((uint16_t)F1TMRR << 8) | F1TLRR;
+#ifdef CPU_FAN2
+    telemetry.fan_duty[1] = PWM_REG(CPU_FAN2);
+    telemetry.fan_tach[1] = ((uint16_t)F2TMRR << 8) | F2TLRR;
+#elif HAVE_DGPU
+    telemetry.fan_duty[1] = PWM_REG(GPU_FAN1);
+    telemetry.fan_tach[1] = ((uint16_t)F2TMRR << 8) | F2TLRR;
+#else
+    telemetry.fan_duty[1] = 0;
+    telemetry.fan_tach[1] = 0;
+#endif
+
+    telemetry.charger_input_current = battery_charger_input_current_ma;
+
+    telemetry.battery_voltage = battery_info.voltage;
+    telemetry.battery_current = (int16_t)battery_info.current;
+    telemetry.battery_charge = battery_info.charge;
+    telemetry.battery_remaining_capacity = battery_info.remaining_capacity;
+    telemetry.battery_full_capacity = battery_info.full_capacity;
+    telemetry.battery_status = battery_info.status;
+
+    // Mark the fields as consistent
+    telemetry.sequence++;
+}
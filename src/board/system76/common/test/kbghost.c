@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: GPL-3.0-only
+//
+// Host test of the ghost detection of the keyboard scan, comparing it to the
+// previous detection that rescanned the matrix for each row
+
+#include <stdio.h>
+
+#include <board/kbghost.h>
+
+#include "test.h"
+
+#define ROWS 18
+#define MATRICES 100000
+
+static uint8_t matrix[ROWS];
+static uint8_t real_keys[ROWS];
+
+// Hardware scan of a row, as used by the previous detection
+static uint8_t get_row(uint8_t row) {
+    return matrix[row];
+}
+
+static inline bool popcount_more_than_one(uint8_t rowdata) {
+    return rowdata & (rowdata - 1);
+}
+
+// Previous detection, reading each other row from the hardware
+static bool reference_ghost_in_row(uint8_t row, uint8_t rowdata) {
+    rowdata &= real_keys[row];
+    if (!popcount_more_than_one(rowdata)) {
+        return false;
+    }
+    for (uint8_t i = 0; i < ROWS; i++) {
+        uint8_t otherrow = get_row(i) & real_keys[i];
+        if (i != row && popcount_more_than_one(otherrow & rowdata)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t seed = 1;
+
+static uint8_t random_byte(void) {
+    seed = seed * 1103515245 + 12345;
+    return (uint8_t)(seed >> 16);
+}
+
+// Known cases on a matrix without blanks
+static void test_cases(void) {
+    for (uint8_t i = 0; i < ROWS; i++) {
+        matrix[i] = 0;
+        real_keys[i] = 0xFF;
+    }
+
+    // Two keys of a row are not a ghost
+    matrix[0] = 0x03;
+    CHECK(!kbghost_in_row(matrix, real_keys, ROWS, 0));
+
+    // Three keys on the corners of a rectangle make a ghost on the fourth
+    matrix[5] = 0x01;
+    CHECK(!kbghost_in_row(matrix, real_keys, ROWS, 0));
+    matrix[5] = 0x03;
+    CHECK(kbghost_in_row(matrix, real_keys, ROWS, 0));
+    CHECK(kbghost_in_row(matrix, real_keys, ROWS, 5));
+    CHECK(!kbghost_in_row(matrix, real_keys, ROWS, 1));
+
+    // Blanks of the matrix are ignored
+    real_keys[5] = 0xFE;
+    CHECK(!kbghost_in_row(matrix, real_keys, ROWS, 0));
+    CHECK(!kbghost_in_row(matrix, real_keys, ROWS, 5));
+}
+
+// Random matrices, with few keys pressed so that ghosts are not too common
+static void test_random(void) {
+    unsigned int ghosts = 0;
+
+    for (unsigned int n = 0; n < MATRICES; n++) {
+        for (uint8_t i = 0; i < ROWS; i++) {
+            matrix[i] = random_byte() & random_byte() & random_byte();
+            real_keys[i] = random_byte() | random_byte();
+        }
+
+        for (uint8_t row = 0; row < ROWS; row++) {
+            bool expected = reference_ghost_in_row(row, matrix[row]);
+            bool ghost = kbghost_in_row(matrix, real_keys, ROWS, row);
+            if (ghost != expected) {
+                printf("matrix %u row %u: %d instead of %d\n", n, row, ghost, expected);
+                failures++;
+            }
+            ghosts += ghost;
+        }
+    }
+
+    // Both outcomes must be covered
+    CHECK(ghosts > 0);
+    CHECK(ghosts < MATRICES * ROWS);
+}
+
+int main(void) {
+    test_cases();
+    test_random();
+    return test_result();
+}
@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: GPL-3.0-only
+//
+// Host test of the task selection of the scheduler
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <board/task.h>
+
+#include "test.h"
+
+static bool pending_value[3] = { true, true, true };
+
+static bool pending_0(void) {
+    return pending_value[0];
+}
+
+static bool pending_1(void) {
+    return pending_value[1];
+}
+
+static bool pending_2(void) {
+    return pending_value[2];
+}
+
+static void run(void) {}
+
+// Of two due tasks, the one with less slack is run first
+static void test_slack(void) {
+    const struct Task tasks[2] = {
+        { "slow", run, NULL, 100, 50 },
+        { "fast", run, NULL, 10, 5 },
+    };
+    uint32_t last[2] = { 0, 0 };
+
+    // At 120 ms: slow has 100 + 50 - 120 = 30, fast has 10 + 5 - 120 < 0
+    CHECK(task_select(tasks, last, 2, 0, 1, 120) == 1);
+    // At 12 ms, only fast is due
+    CHECK(task_select(tasks, last, 2, 0, 1, 12) == 1);
+    // Fast ran at 120 ms, so at 125 ms only slow is due
+    last[1] = 120;
+    CHECK(task_select(tasks, last, 2, 0, 1, 125) == 0);
+    // Nothing is due
+    last[0] = 125;
+    CHECK(task_select(tasks, last, 2, 0, 0, 126) == 2);
+}
+
+// Tasks with equal slack take turns, starting after the current task
+static void test_round_robin(void) {
+    const struct Task tasks[3] = {
+        { "a", run, pending_0, 0, 2 },
+        { "b", run, pending_1, 0, 2 },
+        { "c", run, pending_2, 0, 2 },
+    };
+    uint32_t last[3] = { 0, 0, 0 };
+    uint8_t current = 2;
+    uint8_t order[6];
+
+    for (int i = 0; i < 6; i++) {
+        current = task_select(tasks, last, 3, 0, current, 0);
+        order[i] = current;
+    }
+    CHECK(order[0] == 0 && order[1] == 1 && order[2] == 2);
+    CHECK(order[3] == 0 && order[4] == 1 && order[5] == 2);
+
+    // Tasks without pending work are skipped
+    pending_value[1] = false;
+    CHECK(task_select(tasks, last, 3, 0, 0, 0) == 2);
+    pending_value[0] = false;
+    pending_value[2] = false;
+    CHECK(task_select(tasks, last, 3, 0, 0, 0) == 3);
+    pending_value[0] = pending_value[1] = pending_value[2] = true;
+}
+
+// A triggered task is due even before its period elapsed, or without work
+static void test_trigger(void) {
+    const struct Task tasks[2] = {
+        { "polled", run, pending_0, 1000, 10 },
+        { "urgent", run, NULL, 1000, 1 },
+    };
+    uint32_t last[2] = { 0, 0 };
+
+    CHECK(task_select(tasks, last, 2, 0, 1, 5) == 2);
+    CHECK(task_select(tasks, last, 2, 1U << 1, 1, 5) == 1);
+
+    pending_value[0] = false;
+    CHECK(task_select(tasks, last, 2, 1U << 0, 1, 5) == 0);
+    pending_value[0] = true;
+
+    // The triggered task with the shorter deadline wins
+    CHECK(task_select(tasks, last, 2, (1U << 0) | (1U << 1), 1, 5) == 1);
+}
+
+// Simulate the main loop with tasks that each take 250 us, and check that
+// every task runs within its period and deadline
+static void test_deadlines(void) {
+    const struct Task tasks[4] = {
+        { "scan", run, NULL, 1, 1 },
+        { "host", run, NULL, 0, 2 },
+        { "fan", run, NULL, 250, 10 },
+        { "battery", run, NULL, 1000, 10 },
+    };
+    uint32_t last[4] = { 0, 0, 0, 0 };
+    uint32_t lateness[4] = { 0, 0, 0, 0 };
+    uint8_t current = 3;
+
+    // Time in units of 250 us
+    for (uint32_t quarter = 0; quarter < 40000; quarter++) {
+        uint32_t time = quarter / 4;
+        uint8_t next = task_select(tasks, last, 4, 0, current, time);
+        if (next == 4) {
+            continue;
+        }
+
+        uint32_t late = time - last[next] - tasks[next].period;
+        if (tasks[next].period != 0 && late > lateness[next]) {
+            lateness[next] = late;
+        }
+        last[next] = time;
+        current = next;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        if (lateness[i] > tasks[i].deadline) {
+            printf("%s was %u ms late\n", tasks[i].name, (unsigned int)lateness[i]);
+        }
+        CHECK(lateness[i] <= tasks[i].deadline);
+    }
+}
+
+int main(void) {
+    test_slack();
+    test_round_robin();
+    test_trigger();
+    test_deadlines();
+    return test_result();
+}
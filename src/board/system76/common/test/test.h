@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: GPL-3.0-only
+//
+// Checks shared by the host tests
+
+#ifndef _TEST_TEST_H
+#define _TEST_TEST_H
+
+#include <stdio.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                            \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+// Exit status of the test, failing if any check failed
+static inline int test_result(void) {
+    return failures ? 1 : 0;
+}
+
+#endif // _TEST_TEST_H
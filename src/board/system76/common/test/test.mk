@@ -0,0 +1,26 @@
+# SPDX-License-Identifier: GPL-3.0-only
+
+# Host tests of hardware independent code, run with `make BOARD=<board> test`.
+# The tested code is kept in its own source files, free of hardware access, so
+# that it can be built on the host.
+
+TEST_DIR=$(SYSTEM76_COMMON_DIR)/test
+TEST_BUILD=$(BUILD)/test
+TEST_CFLAGS=-I$(COMMON_DIR)/include -I$(SYSTEM76_COMMON_DIR)/include -D__code= -D__xdata= -Wall -Wextra -Werror
+HOSTCC?=gcc
+
+TEST_BIN=$(TEST_BUILD)/kbghost $(TEST_BUILD)/task
+
+.PHONY: test
+test: $(TEST_BIN)
+	for test in $^; do echo "  TEST      $$(basename $$test)"; $$test || exit 1; done
+
+$(TEST_BUILD)/kbghost: $(TEST_DIR)/kbghost.c $(TEST_DIR)/test.h $(SYSTEM76_COMMON_DIR)/kbghost.c $(SYSTEM76_COMMON_DIR)/include/board/kbghost.h
+	@echo "  HOSTCC    $(subst $(obj)/,,$@)"
+	mkdir -p $(@D)
+	$(HOSTCC) $(TEST_CFLAGS) -o $@ $(filter %.c, $^)
+
+$(TEST_BUILD)/task: $(TEST_DIR)/task.c $(TEST_DIR)/test.h $(SYSTEM76_COMMON_DIR)/task_select.c $(SYSTEM76_COMMON_DIR)/include/board/task.h
+	@echo "  HOSTCC    $(subst $(obj)/,,$@)"
+	mkdir -p $(@D)
+	$(HOSTCC) $(TEST_CFLAGS) -o $@ $(filter %.c, $^)
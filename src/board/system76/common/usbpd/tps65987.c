@@ -4,6 +4,7 @@
 // I2C register reference: https://www.ti.com/lit/ug/slvubh2b/slvubh2b.pdf
 
 #include <arch/time.h>
+#include <board/acpi.h>
 #include <board/battery.h>
 #include <board/gpio.h>
 #include <board/power.h>
@@ -365,6 +366,8 @@ void usbpd_event(void) {
             battery_charger_disable();
             // In case power was renegotiated without power loss
             power_apply_limit(true);
+            // Input power and D-notify level depend on the limit
+            acpi_update_power();
         }
     }
 
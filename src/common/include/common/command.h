@@ -60,6 +60,16 @@ enum Command {
     CMD_OPTION_GET = 25,
     // Set a persistent option by index
     CMD_OPTION_SET = 26,
+    // Get execution time profile of a main loop task
+    CMD_PROFILE_GET = 27,
+    // Calibrate keyboard matrix settle times
+    CMD_MATRIX_CALIBRATE = 28,
+    // Get keypress to host latency histogram
+    CMD_LATENCY_GET = 29,
+    // Get ACPI traffic counters
+    CMD_ACPI_STATS = 30,
+    // Run several commands in one round trip
+    CMD_BATCH = 31,
     //TODO
 };
 
@@ -71,6 +81,11 @@ enum Result {
     //TODO
 };
 
+enum CommandProbeFeature {
+    // Telemetry is published in the H2RAM telemetry window
+    CMD_PROBE_FEATURE_TELEMETRY = BIT(0),
+};
+
 enum CommandSpiFlag {
     // Read from SPI chip if set, write otherwise
     CMD_SPI_FLAG_READ = BIT(0),
@@ -84,6 +99,17 @@ enum CommandSpiFlag {
 
 #define CMD_LED_INDEX_ALL 0xFF
 
+enum CommandMatrixCalibrate {
+    // Report calibration state only
+    CMD_MATRIX_CALIBRATE_GET = 0,
+    // Start measuring settle times
+    CMD_MATRIX_CALIBRATE_START = 1,
+    // Stop measuring and scan with the measured settle times
+    CMD_MATRIX_CALIBRATE_APPLY = 2,
+    // Stop measuring and keep the current settle times
+    CMD_MATRIX_CALIBRATE_CANCEL = 3,
+};
+
 enum SecurityState {
     // Default value, flashing is prevented, cannot be set with CMD_SECURITY_SET
     SECURITY_STATE_LOCK = 0,
@@ -17,32 +17,39 @@
 #define LEVEL LEVEL_INFO
 #endif
 
+// Scratch ROMs do not include the logger, so always print text there
+#if CONFIG_LOG_TOKENS && !defined(__SCRATCH__) && !defined(__FLASH__)
+#include <common/log.h>
+#else
+#define LOG_PRINT(...) printf(__VA_ARGS__)
+#endif
+
 #if LEVEL >= LEVEL_TRACE
-#define TRACE(...) printf(__VA_ARGS__)
+#define TRACE(...) LOG_PRINT(__VA_ARGS__)
 #else
 #define TRACE(...)
 #endif
 
 #if LEVEL >= LEVEL_DEBUG
-#define DEBUG(...) printf(__VA_ARGS__)
+#define DEBUG(...) LOG_PRINT(__VA_ARGS__)
 #else
 #define DEBUG(...)
 #endif
 
 #if LEVEL >= LEVEL_INFO
-#define INFO(...) printf(__VA_ARGS__)
+#define INFO(...) LOG_PRINT(__VA_ARGS__)
 #else
 #define INFO(...)
 #endif
 
 #if LEVEL >= LEVEL_WARN
-#define WARN(...) printf(__VA_ARGS__)
+#define WARN(...) LOG_PRINT(__VA_ARGS__)
 #else
 #define WARN(...)
 #endif
 
 #if LEVEL >= LEVEL_ERROR
-#define ERROR(...) printf(__VA_ARGS__)
+#define ERROR(...) LOG_PRINT(__VA_ARGS__)
 #else
 #define ERROR(...)
 #endif
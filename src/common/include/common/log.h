@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+// Tokenized logging. Instead of formatting messages, log calls send a token
+// identifying their format string, followed by their arguments in binary. The
+// format strings are extracted at build time by scripts/log_tokens.py, which
+// generates the tokens of every call site and a dictionary used by the host to
+// decode the output.
+//
+// A token is written as LOG_TOKEN_MARKER, the 16-bit ID of the format string,
+// then each argument in little endian order, with its size given by the kind
+// of the conversion in the format string. Strings are sent with their NUL.
+//
+// Call sites are identified by file and line, so log calls must be made from
+// source files and not headers. Calls the script cannot extract, such as
+// those inside macro definitions, still use printf.
+
+#ifndef _COMMON_LOG_H
+#define _COMMON_LOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <log_tokens.h>
+
+// Start of a token, never used in text
+#define LOG_TOKEN_MARKER 0xFF
+
+// Kinds of arguments, must match scripts/log_tokens.py
+#define LOG_ARG_CHAR 'b'
+#define LOG_ARG_INT 'i'
+#define LOG_ARG_LONG 'l'
+#define LOG_ARG_LONG_LONG 'q'
+#define LOG_ARG_POINTER 'p'
+#define LOG_ARG_STRING 's'
+
+// Send a token with arguments of the kinds in spec
+void log_token(uint16_t id, const char *spec, ...);
+
+// The generated LOG_TOKEN_<file>_<line> expands to "~, 1, <id>, <spec>" for
+// call sites with a token, and is left undefined otherwise
+#define LOG_SITE(file, line) LOG_SITE_(file, line)
+#define LOG_SITE_(file, line) LOG_TOKEN_##file##_##line
+
+#define LOG_HAS(...) LOG_HAS_(__VA_ARGS__, 0, 0, 0, 0)
+#define LOG_HAS_(marker, has, ...) has
+#define LOG_ID(...) LOG_ID_(__VA_ARGS__, 0, 0, 0, 0)
+#define LOG_ID_(marker, has, id, ...) id
+#define LOG_SPEC(...) LOG_SPEC_(__VA_ARGS__, 0, 0, 0, 0)
+#define LOG_SPEC_(marker, has, id, spec, ...) spec
+
+#define LOG_CALL(has, ...) LOG_CALL_(has, __VA_ARGS__)
+#define LOG_CALL_(has, ...) LOG_CALL_##has(__VA_ARGS__)
+#define LOG_CALL_0(id, spec, ...) printf(__VA_ARGS__)
+#define LOG_CALL_1(id, spec, fmt, ...) log_token(id, spec, ##__VA_ARGS__)
+
+// Log a message, as a token if the call site has one
+#define LOG_PRINT(...) LOG_PRINT_(LOG_SITE(LOG_FILE, __LINE__), __VA_ARGS__)
+#define LOG_PRINT_(site, ...)                                                  \
+    LOG_CALL(LOG_HAS(site), LOG_ID(site), LOG_SPEC(site), __VA_ARGS__)
+
+#endif // _COMMON_LOG_H
@@ -5,6 +5,7 @@ ec-y += adc.c
 ec-$(CONFIG_BUS_ESPI) += espi.c
 ec-y += gpio.c
 ec-y += i2c.c
+ec-y += intc.c
 ec-y += kbc.c
 ec-y += pmc.c
 ec-y += ps2.c
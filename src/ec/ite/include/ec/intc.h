@@ -127,6 +127,27 @@ volatile uint8_t __xdata __at(0x115B) IPOLR21;
 // Interrupt Vector Register
 volatile uint8_t __xdata __at(0x1110) IVCT;
 
+// INTC interrupt sources
+#define INTC_IRQ_NONE 0
+#define INTC_IRQ_KBC_OBE 2
+#define INTC_IRQ_PMC_OBE 3
+#define INTC_IRQ_WKINTC 13
+#define INTC_IRQ_PS2_3 18
+#define INTC_IRQ_PS2_2 19
+#define INTC_IRQ_PS2_1 20
+#define INTC_IRQ_SMFI 22
+#define INTC_IRQ_KBC_IBF 24
+#define INTC_IRQ_PMC_IBF 25
+#define INTC_IRQ_PMC2_OBE 26
+#define INTC_IRQ_PMC2_IBF 27
+
+// Enable an interrupt source, triggered on its rising edge
+void intc_enable(uint8_t irq);
+// Disable an interrupt source
+void intc_disable(uint8_t irq);
+// Clear the pending status of an edge-triggered interrupt source
+void intc_clear(uint8_t irq);
+
 /**
  * Return the highest priority pending IRQ.
  */
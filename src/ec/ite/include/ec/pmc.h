@@ -28,6 +28,7 @@ extern struct Pmc __code PMC_5;
 #define PMC_STS_OBF BIT(0)
 #define PMC_STS_IBF BIT(1)
 #define PMC_STS_CMD BIT(3)
+#define PMC_STS_BURST BIT(4)
 
 uint8_t pmc_status(struct Pmc *pmc);
 void pmc_set_status(struct Pmc *pmc, uint8_t status);
@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <ec/intc.h>
+#include <common/macro.h>
+
+// Groups 0 to 3 have each register type grouped together, and the remaining
+// groups have the four registers of each group together
+static volatile uint8_t __xdata *intc_reg(uint8_t irq, uint8_t reg) {
+    uint8_t group = irq >> 3;
+    if (group < 4) {
+        return &ISR0 + group + (reg << 2);
+    } else {
+        return &ISR4 + ((group - 4) << 2) + reg;
+    }
+}
+
+#define INTC_ISR 0
+#define INTC_IER 1
+#define INTC_IELMR 2
+#define INTC_IPOLR 3
+
+void intc_enable(uint8_t irq) {
+    uint8_t mask = BIT(irq & 7);
+    // Edge-triggered
+    *intc_reg(irq, INTC_IELMR) |= mask;
+    // Rising edge
+    *intc_reg(irq, INTC_IPOLR) &= ~mask;
+    // Clear stale status before enabling
+    *intc_reg(irq, INTC_ISR) = mask;
+    *intc_reg(irq, INTC_IER) |= mask;
+}
+
+void intc_disable(uint8_t irq) {
+    *intc_reg(irq, INTC_IER) &= ~BIT(irq & 7);
+}
+
+void intc_clear(uint8_t irq) {
+    // Status is cleared by writing 1
+    *intc_reg(irq, INTC_ISR) = BIT(irq & 7);
+}
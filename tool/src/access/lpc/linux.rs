@@ -24,14 +24,74 @@ use crate::{
 
 use super::*;
 
+/// Second host interface (PMC2) data port, the command and status port is at 0x6C
+const PMC2_BASE: u16 = 0x68;
+const PMC2_SIZE: usize = 5;
+
+const PMC_DATA: u16 = 0;
+const PMC_CMD: u16 = 4;
+const PMC_STS_OBF: u8 = 1 << 0;
+const PMC_STS_IBF: u8 = 1 << 1;
+
+/// ACPI EC read command
+const PMC_ACPI_READ: u8 = 0x80;
+
+/// Direct port I/O, which avoids a seek and a syscall for every byte
+#[cfg(any(target_arch = "x86", target_arch = "x86_64"))]
+mod port_io {
+    use core::arch::asm;
+    use std::io;
+
+    /// Allow port I/O for the process on ports start to start + len - 1 only
+    pub unsafe fn enable(start: u16, len: u16) -> io::Result<()> {
+        if libc::syscall(libc::SYS_ioperm, start as libc::c_ulong, len as libc::c_ulong, 1) < 0 {
+            return Err(io::Error::last_os_error());
+        }
+        Ok(())
+    }
+
+    pub unsafe fn inb(port: u16) -> u8 {
+        let value: u8;
+        asm!("in al, dx", out("al") value, in("dx") port, options(nomem, nostack, preserves_flags));
+        value
+    }
+
+    pub unsafe fn outb(port: u16, value: u8) {
+        asm!("out dx, al", in("dx") port, in("al") value, options(nomem, nostack, preserves_flags));
+    }
+}
+
+#[cfg(not(any(target_arch = "x86", target_arch = "x86_64")))]
+mod port_io {
+    use std::io;
+
+    pub unsafe fn enable(_start: u16, _len: u16) -> io::Result<()> {
+        Err(io::Error::new(
+            io::ErrorKind::Other,
+            "port I/O is not supported on this architecture"
+        ))
+    }
+
+    pub unsafe fn inb(_port: u16) -> u8 {
+        unreachable!()
+    }
+
+    pub unsafe fn outb(_port: u16, _value: u8) {
+        unreachable!()
+    }
+}
+
 struct PortLock {
     start: u16,
     len: u16,
     file: fs::File,
+    direct: bool,
 }
 
 impl PortLock {
-    pub fn new(start: u16, end: u16) -> io::Result<Self> {
+    /// Lock ports, using port I/O instead of /dev/port if direct is set. Port I/O is then enabled
+    /// for the locked ports only
+    pub fn new(start: u16, end: u16, direct: bool) -> io::Result<Self> {
         if end < start {
             return Err(io::Error::new(
                 io::ErrorKind::InvalidInput,
@@ -57,20 +117,29 @@ impl PortLock {
             return Err(io::Error::last_os_error());
         }
 
+        if direct {
+            unsafe { port_io::enable(start, len)? };
+        }
+
         Ok(Self {
             start,
             len,
             file,
+            direct,
         })
     }
 
-    fn seek(&mut self, offset: u16) -> io::Result<()> {
-        if offset >= self.len {
+    fn check(&self, offset: u16, count: usize) -> io::Result<()> {
+        if offset as usize + count > self.len as usize {
             return Err(io::Error::new(
                 io::ErrorKind::InvalidInput,
-                "PortLock::seek: offset >= len"
+                "PortLock: offset + count > len"
             ));
         }
+        Ok(())
+    }
+
+    fn seek(&mut self, offset: u16) -> io::Result<()> {
         let port = self.start + offset;
         let pos = self.file.seek(SeekFrom::Start(port as u64))?;
         if pos != port as u64 {
@@ -83,28 +152,72 @@ impl PortLock {
     }
 
     pub fn read(&mut self, offset: u16) -> io::Result<u8> {
-        self.seek(offset)?;
         let mut data = [0];
-        self.file.read_exact(&mut data)?;
+        self.read_block(offset, &mut data)?;
         Ok(data[0])
     }
 
+    /// Read consecutive ports. With /dev/port, this is a single syscall
+    pub fn read_block(&mut self, offset: u16, data: &mut [u8]) -> io::Result<()> {
+        self.check(offset, data.len())?;
+        if data.is_empty() {
+            return Ok(());
+        }
+        if self.direct {
+            for i in 0..data.len() {
+                data[i] = unsafe { port_io::inb(self.start + offset + i as u16) };
+            }
+            return Ok(());
+        }
+        self.seek(offset)?;
+        self.file.read_exact(data)
+    }
+
     pub fn write(&mut self, offset: u16, value: u8) -> io::Result<()> {
+        self.write_block(offset, &[value])
+    }
+
+    /// Write consecutive ports, in order. With /dev/port, this is a single syscall
+    pub fn write_block(&mut self, offset: u16, data: &[u8]) -> io::Result<()> {
+        self.check(offset, data.len())?;
+        if data.is_empty() {
+            return Ok(());
+        }
+        if self.direct {
+            for i in 0..data.len() {
+                unsafe { port_io::outb(self.start + offset + i as u16, data[i]) };
+            }
+            return Ok(());
+        }
         self.seek(offset)?;
-        self.file.write_all(&[value])
+        self.file.write_all(data)
     }
 }
 
-/// Use /dev/port access with file locking
+/// Use /dev/port access with file locking, or port I/O with the same locking
 pub struct AccessLpcLinux {
+    telemetry: Option<PortLock>,
+    acpi: Option<PortLock>,
+    pmc2: Option<PortLock>,
     cmd: PortLock,
     dbg: PortLock,
+    direct: bool,
     timeout: StdTimeout,
 }
 
 impl AccessLpcLinux {
     /// Locks ports and then returns access object
     pub unsafe fn new(timeout: Duration) -> Result<Self, Error> {
+        Self::new_inner(timeout, false)
+    }
+
+    /// Locks ports and then returns access object using port I/O, which is much faster than
+    /// /dev/port for commands. Requires x86 and the CAP_SYS_RAWIO capability
+    pub unsafe fn new_direct(timeout: Duration) -> Result<Self, Error> {
+        Self::new_inner(timeout, true)
+    }
+
+    unsafe fn new_inner(timeout: Duration, direct: bool) -> Result<Self, Error> {
         // TODO: is there a better way to probe before running a command?
         if ! Path::new("/sys/bus/acpi/devices/17761776:00").is_dir() &&
            ! Path::new("/sys/bus/acpi/devices/DASHEC00:00").is_dir() &&
@@ -116,15 +229,32 @@ impl AccessLpcLinux {
             )));
         }
 
-        let cmd = PortLock::new(SMFI_CMD_BASE, SMFI_CMD_BASE + SMFI_CMD_SIZE as u16 - 1)?;
-        let dbg = PortLock::new(SMFI_DBG_BASE, SMFI_DBG_BASE + SMFI_DBG_SIZE as u16 - 1)?;
+        let cmd = PortLock::new(SMFI_CMD_BASE, SMFI_CMD_BASE + SMFI_CMD_SIZE as u16 - 1, direct)?;
+        let dbg = PortLock::new(SMFI_DBG_BASE, SMFI_DBG_BASE + SMFI_DBG_SIZE as u16 - 1, direct)?;
         Ok(Self {
+            telemetry: None,
+            acpi: None,
+            pmc2: None,
             cmd,
             dbg,
+            direct,
             timeout: StdTimeout::new(timeout),
         })
     }
 
+    /// Lock ports on first use, so that only the subcommands reading them hold them
+    fn lock_lazy(
+        lock: &mut Option<PortLock>,
+        start: u16,
+        size: usize,
+        direct: bool
+    ) -> io::Result<&mut PortLock> {
+        if lock.is_none() {
+            *lock = Some(PortLock::new(start, start + size as u16 - 1, direct)?);
+        }
+        Ok(lock.as_mut().unwrap())
+    }
+
     /// Read from the command space
     unsafe fn read_cmd(&mut self, addr: u8) -> Result<u8, Error> {
         Ok(self.cmd.read(addr as u16)?)
@@ -135,6 +265,16 @@ impl AccessLpcLinux {
         Ok(self.cmd.write(addr as u16, data)?)
     }
 
+    /// Returns Ok if the bits of mask in the PMC2 status equal value. PMC2 must be locked
+    unsafe fn pmc2_status(&mut self, mask: u8, value: u8) -> Result<(), Error> {
+        let pmc2 = self.pmc2.as_mut().unwrap();
+        if pmc2.read(PMC_CMD)? & mask == value {
+            Ok(())
+        } else {
+            Err(Error::WouldBlock)
+        }
+    }
+
     /// Returns Ok if a command can be sent
     unsafe fn command_check(&mut self) -> Result<(), Error> {
         if self.read_cmd(SMFI_CMD_CMD)? == 0 {
@@ -155,10 +295,8 @@ impl Access for AccessLpcLinux {
         // All previous commands should be finished
         self.command_check()?;
 
-        // Write data bytes, index should be valid due to length test above
-        for i in 0..data.len() {
-            self.write_cmd(i as u8 + SMFI_CMD_DATA, data[i])?;
-        }
+        // Write data bytes, length should be valid due to length test above
+        self.cmd.write_block(SMFI_CMD_DATA as u16, data)?;
 
         // Write command byte, which starts command
         self.write_cmd(SMFI_CMD_CMD, cmd as u8)?;
@@ -167,10 +305,8 @@ impl Access for AccessLpcLinux {
         self.timeout.reset();
         timeout!(self.timeout, self.command_check())?;
 
-        // Read data bytes, index should be valid due to length test above
-        for i in 0..data.len() {
-            data[i] = self.read_cmd(i as u8 + SMFI_CMD_DATA)?;
-        }
+        // Read data bytes, length should be valid due to length test above
+        self.cmd.read_block(SMFI_CMD_DATA as u16, data)?;
 
         // Return response byte
         self.read_cmd(SMFI_CMD_RES)
@@ -183,4 +319,50 @@ impl Access for AccessLpcLinux {
     unsafe fn read_debug(&mut self, addr: u8) -> Result<u8, Error> {
         Ok(self.dbg.read(addr as u16)?)
     }
+
+    unsafe fn read_debug_block(&mut self, addr: u8, data: &mut [u8]) -> Result<(), Error> {
+        Ok(self.dbg.read_block(addr as u16, data)?)
+    }
+
+    unsafe fn read_acpi(&mut self, addr: u8) -> Result<u8, Error> {
+        let acpi = Self::lock_lazy(&mut self.acpi, SMFI_ACPI_BASE, SMFI_ACPI_SIZE, self.direct)?;
+        Ok(acpi.read(addr as u16)?)
+    }
+
+    unsafe fn read_acpi_pmc2(&mut self, addr: u8) -> Result<u8, Error> {
+        Self::lock_lazy(&mut self.pmc2, PMC2_BASE, PMC2_SIZE, self.direct)?;
+
+        // Discard output left by an interrupted transaction
+        if self.pmc2_status(PMC_STS_OBF, PMC_STS_OBF).is_ok() {
+            self.pmc2.as_mut().unwrap().read(PMC_DATA)?;
+        }
+
+        self.timeout.reset();
+        timeout!(self.timeout, self.pmc2_status(PMC_STS_IBF, 0))?;
+        self.pmc2.as_mut().unwrap().write(PMC_CMD, PMC_ACPI_READ)?;
+        timeout!(self.timeout, self.pmc2_status(PMC_STS_IBF, 0))?;
+        self.pmc2.as_mut().unwrap().write(PMC_DATA, addr)?;
+        timeout!(self.timeout, self.pmc2_status(PMC_STS_OBF, PMC_STS_OBF))?;
+        Ok(self.pmc2.as_mut().unwrap().read(PMC_DATA)?)
+    }
+
+    unsafe fn read_telemetry(&mut self, addr: u8) -> Result<u8, Error> {
+        let telemetry = Self::lock_lazy(
+            &mut self.telemetry,
+            SMFI_TELEMETRY_BASE,
+            SMFI_TELEMETRY_SIZE,
+            self.direct
+        )?;
+        Ok(telemetry.read(addr as u16)?)
+    }
+
+    unsafe fn read_telemetry_block(&mut self, addr: u8, data: &mut [u8]) -> Result<(), Error> {
+        let telemetry = Self::lock_lazy(
+            &mut self.telemetry,
+            SMFI_TELEMETRY_BASE,
+            SMFI_TELEMETRY_SIZE,
+            self.direct
+        )?;
+        Ok(telemetry.read_block(addr as u16, data)?)
+    }
 }
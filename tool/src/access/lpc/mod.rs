@@ -1,5 +1,15 @@
 // SPDX-License-Identifier: MIT
 
+#[cfg(feature = "std")]
+const SMFI_TELEMETRY_BASE: u16 = 0xC00;
+#[cfg(all(feature = "std", target_os = "linux"))]
+const SMFI_TELEMETRY_SIZE: usize = 0x20;
+
+#[cfg(feature = "std")]
+const SMFI_ACPI_BASE: u16 = 0xD00;
+#[cfg(all(feature = "std", target_os = "linux"))]
+const SMFI_ACPI_SIZE: usize = 0x100;
+
 const SMFI_CMD_BASE: u16 = 0xE00;
 const SMFI_CMD_SIZE: usize = 0x100;
 
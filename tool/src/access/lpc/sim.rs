@@ -2,7 +2,7 @@
 
 use std::{
     io,
-    net::UdpSocket,
+    net::{ToSocketAddrs, UdpSocket},
     time::Duration,
 };
 
@@ -16,50 +16,153 @@ use crate::{
 
 use super::*;
 
+// Message kinds of the simulator protocol. Requests are the kind, the port address in little
+// endian, and a value. Block requests use the value as the number of bytes, and block writes are
+// followed by the bytes to write.
+const SIM_PROBE: u8 = 0x00;
+const SIM_INB: u8 = 0x01;
+const SIM_OUTB: u8 = 0x02;
+const SIM_INB_BLOCK: u8 = 0x03;
+const SIM_OUTB_BLOCK: u8 = 0x04;
+
+// Simulators without block messages may not reply to them
+const SIM_BLOCK_PROBE_TIMEOUT: Duration = Duration::from_millis(100);
+
 pub struct AccessLpcSim {
     socket: UdpSocket,
     timeout: StdTimeout,
+    block: bool,
 }
 
 impl AccessLpcSim {
     pub unsafe fn new(timeout: Duration) -> Result<Self, Error> {
+        Self::connect("127.0.0.1:8587", timeout)
+    }
+
+    fn connect<A: ToSocketAddrs>(addr: A, timeout: Duration) -> Result<Self, Error> {
         let socket = UdpSocket::bind("127.0.0.1:0")?;
-        socket.connect("127.0.0.1:8587")?;
+        socket.connect(addr)?;
         let mut access = Self {
             socket,
             timeout: StdTimeout::new(timeout),
+            block: false,
         };
-        access.transaction(0x00, 0, 0)?;
+        access.transaction(SIM_PROBE, 0, 0)?;
+        access.block = access.probe_block()?;
         Ok(access)
     }
 
-    fn transaction(&mut self, kind: u8, addr: u16, value: u8) -> io::Result<u8> {
-        let addr = addr.to_le_bytes();
-        let request = [kind as u8, addr[0], addr[1], value];
-        if self.socket.send(&request)? != request.len() {
+    /// Returns true if the simulator replies to block reads with all requested bytes
+    fn probe_block(&mut self) -> io::Result<bool> {
+        let addr = SMFI_CMD_BASE.to_le_bytes();
+        let request = [SIM_INB_BLOCK, addr[0], addr[1], 2];
+        self.socket.send(&request)?;
+
+        self.socket.set_read_timeout(Some(SIM_BLOCK_PROBE_TIMEOUT))?;
+        let mut response = [0; 2];
+        let result = self.socket.recv(&mut response);
+        self.socket.set_read_timeout(None)?;
+        let block = match result {
+            Ok(count) => count == response.len(),
+            Err(err) if err.kind() == io::ErrorKind::WouldBlock || err.kind() == io::ErrorKind::TimedOut => false,
+            Err(err) => return Err(err),
+        };
+
+        // Replies of simulators without block messages would be taken as replies to later
+        // requests, so drop any that already arrived
+        if !block {
+            self.drain()?;
+        }
+        Ok(block)
+    }
+
+    /// Drop received messages without waiting for more
+    fn drain(&mut self) -> io::Result<()> {
+        self.socket.set_nonblocking(true)?;
+        let mut response = [0; 256];
+        let result = loop {
+            match self.socket.recv(&mut response) {
+                Ok(_) => (),
+                Err(err) if err.kind() == io::ErrorKind::WouldBlock => break Ok(()),
+                Err(err) => break Err(err),
+            }
+        };
+        self.socket.set_nonblocking(false)?;
+        result
+    }
+
+    fn request(&mut self, request: &[u8], response: &mut [u8]) -> io::Result<()> {
+        if self.socket.send(request)? != request.len() {
             return Err(io::Error::new(
                 io::ErrorKind::UnexpectedEof,
                 "Socket request incorrect size"
             ));
         }
 
-        let mut response = [0];
-        if self.socket.recv(&mut response)? != response.len() {
+        if self.socket.recv(response)? != response.len() {
             return Err(io::Error::new(
                 io::ErrorKind::UnexpectedEof,
                 "Socket response incorrect size"
             ));
         }
 
+        Ok(())
+    }
+
+    fn transaction(&mut self, kind: u8, addr: u16, value: u8) -> io::Result<u8> {
+        let addr = addr.to_le_bytes();
+        let request = [kind as u8, addr[0], addr[1], value];
+        let mut response = [0];
+        self.request(&request, &mut response)?;
         Ok(response[0])
     }
 
     pub fn inb(&mut self, addr: u16) -> Result<u8, Error> {
-        Ok(self.transaction(0x01, addr, 0)?)
+        Ok(self.transaction(SIM_INB, addr, 0)?)
     }
 
     pub fn outb(&mut self, addr: u16, value: u8) -> Result<(), Error> {
-        self.transaction(0x02, addr, value)?;
+        self.transaction(SIM_OUTB, addr, value)?;
+        Ok(())
+    }
+
+    /// Read consecutive ports, with one message for every 255 bytes if supported
+    pub fn inb_block(&mut self, addr: u16, data: &mut [u8]) -> Result<(), Error> {
+        if !self.block {
+            for i in 0..data.len() {
+                data[i] = self.inb(addr + i as u16)?;
+            }
+            return Ok(());
+        }
+
+        let mut addr = addr;
+        for chunk in data.chunks_mut(255) {
+            let bytes = addr.to_le_bytes();
+            let request = [SIM_INB_BLOCK, bytes[0], bytes[1], chunk.len() as u8];
+            self.request(&request, chunk)?;
+            addr += chunk.len() as u16;
+        }
+        Ok(())
+    }
+
+    /// Write consecutive ports in order, with one message for every 255 bytes if supported
+    pub fn outb_block(&mut self, addr: u16, data: &[u8]) -> Result<(), Error> {
+        if !self.block {
+            for i in 0..data.len() {
+                self.outb(addr + i as u16, data[i])?;
+            }
+            return Ok(());
+        }
+
+        let mut addr = addr;
+        for chunk in data.chunks(255) {
+            let bytes = addr.to_le_bytes();
+            let mut request = vec![SIM_OUTB_BLOCK, bytes[0], bytes[1], chunk.len() as u8];
+            request.extend_from_slice(chunk);
+            let mut response = [0];
+            self.request(&request, &mut response)?;
+            addr += chunk.len() as u16;
+        }
         Ok(())
     }
 
@@ -93,10 +196,8 @@ impl Access for AccessLpcSim {
         // All previous commands should be finished
         self.command_check()?;
 
-        // Write data bytes, index should be valid due to length test above
-        for i in 0..data.len() {
-            self.write_cmd(i as u8 + SMFI_CMD_DATA, data[i])?;
-        }
+        // Write data bytes, length should be valid due to length test above
+        self.outb_block(SMFI_CMD_BASE + u16::from(SMFI_CMD_DATA), data)?;
 
         // Write command byte, which starts command
         self.write_cmd(SMFI_CMD_CMD, cmd as u8)?;
@@ -105,10 +206,8 @@ impl Access for AccessLpcSim {
         self.timeout.reset();
         timeout!(self.timeout, self.command_check())?;
 
-        // Read data bytes, index should be valid due to length test above
-        for i in 0..data.len() {
-            data[i] = self.read_cmd(i as u8 + SMFI_CMD_DATA)?;
-        }
+        // Read data bytes, length should be valid due to length test above
+        self.inb_block(SMFI_CMD_BASE + u16::from(SMFI_CMD_DATA), data)?;
 
         // Return response byte
         self.read_cmd(SMFI_CMD_RES)
@@ -121,4 +220,112 @@ impl Access for AccessLpcSim {
     unsafe fn read_debug(&mut self, addr: u8) -> Result<u8, Error> {
         self.inb(SMFI_DBG_BASE + u16::from(addr))
     }
+
+    unsafe fn read_debug_block(&mut self, addr: u8, data: &mut [u8]) -> Result<(), Error> {
+        if usize::from(addr) + data.len() > 0x100 {
+            return Err(Error::DataLength(data.len()));
+        }
+        self.inb_block(SMFI_DBG_BASE + u16::from(addr), data)
+    }
+
+    unsafe fn read_acpi(&mut self, addr: u8) -> Result<u8, Error> {
+        self.inb(SMFI_ACPI_BASE + u16::from(addr))
+    }
+
+    unsafe fn read_telemetry(&mut self, addr: u8) -> Result<u8, Error> {
+        self.inb(SMFI_TELEMETRY_BASE + u16::from(addr))
+    }
+
+    unsafe fn read_telemetry_block(&mut self, addr: u8, data: &mut [u8]) -> Result<(), Error> {
+        if usize::from(addr) + data.len() > SMFI_TELEMETRY_SIZE {
+            return Err(Error::DataLength(data.len()));
+        }
+        self.inb_block(SMFI_TELEMETRY_BASE + u16::from(addr), data)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::thread;
+
+    use super::*;
+
+    /// Serve requests on socket with every port reading as the low byte of its address until
+    /// written. Block messages are only supported if block is set, otherwise they get one byte
+    fn simulator(socket: UdpSocket, block: bool) {
+        socket.set_read_timeout(Some(Duration::from_secs(5))).unwrap();
+        thread::spawn(move || {
+            let mut ports: Vec<u8> = (0..=0xFFFF).map(|addr: u32| addr as u8).collect();
+            let mut request = [0; 260];
+            while let Ok((count, peer)) = socket.recv_from(&mut request) {
+                let addr = u16::from_le_bytes([request[1], request[2]]) as usize;
+                let len = request[3] as usize;
+                match request[0] {
+                    SIM_PROBE => socket.send_to(&[0], peer),
+                    SIM_INB => socket.send_to(&[ports[addr]], peer),
+                    SIM_OUTB => {
+                        ports[addr] = request[3];
+                        socket.send_to(&[0], peer)
+                    },
+                    SIM_INB_BLOCK if block => socket.send_to(&ports[addr..addr + len], peer),
+                    SIM_OUTB_BLOCK if block => {
+                        assert_eq!(count, 4 + len);
+                        ports[addr..addr + len].copy_from_slice(&request[4..count]);
+                        socket.send_to(&[0], peer)
+                    },
+                    _ => socket.send_to(&[0xEE], peer),
+                }.unwrap();
+            }
+        });
+    }
+
+    #[test]
+    fn block() {
+        let socket = UdpSocket::bind("127.0.0.1:0").unwrap();
+        let addr = socket.local_addr().unwrap();
+        simulator(socket, true);
+
+        let mut access = AccessLpcSim::connect(addr, Duration::new(1, 0)).unwrap();
+        assert!(access.block);
+
+        // More than one message per transfer
+        let data: Vec<u8> = (0..300).map(|i: u32| (i * 7) as u8).collect();
+        access.outb_block(0x1000, &data).unwrap();
+        let mut read = vec![0; data.len()];
+        access.inb_block(0x1000, &mut read).unwrap();
+        assert_eq!(read, data);
+        assert_eq!(access.inb(0x1000 + 299).unwrap(), data[299]);
+        assert_eq!(access.inb(0x1000 + 300).unwrap(), 0x2C);
+    }
+
+    #[test]
+    fn no_block() {
+        let sim = UdpSocket::bind("127.0.0.1:0").unwrap();
+        let socket = UdpSocket::bind("127.0.0.1:0").unwrap();
+        socket.connect(sim.local_addr().unwrap()).unwrap();
+        let mut access = AccessLpcSim {
+            socket,
+            timeout: StdTimeout::new(Duration::new(1, 0)),
+            block: false,
+        };
+
+        // Queue a short reply to the block probe, and a stale one after it
+        let client = access.socket.local_addr().unwrap();
+        sim.send_to(&[0xEE], client).unwrap();
+        sim.send_to(&[0xEE], client).unwrap();
+        assert!(!access.probe_block().unwrap());
+        let mut request = [0; 4];
+        assert_eq!(sim.recv(&mut request).unwrap(), 4);
+        assert_eq!(request[0], SIM_INB_BLOCK);
+
+        // The stale reply is not taken as the reply to later requests
+        simulator(sim, false);
+        assert_eq!(access.inb(0x1234).unwrap(), 0x34);
+
+        let data = [1, 2, 3];
+        access.outb_block(0x2000, &data).unwrap();
+        let mut read = [0; 3];
+        access.inb_block(0x2000, &mut read).unwrap();
+        assert_eq!(read, data);
+    }
 }
@@ -35,6 +35,38 @@ pub trait Access: Downcast + Send + 'static {
     unsafe fn read_debug(&mut self, _addr: u8) -> Result<u8, Error> {
         Err(Error::NotSupported)
     }
+
+    /// Read consecutive bytes from the debug space
+    unsafe fn read_debug_block(&mut self, addr: u8, data: &mut [u8]) -> Result<(), Error> {
+        for i in 0..data.len() {
+            data[i] = self.read_debug(addr.wrapping_add(i as u8))?;
+        }
+        Ok(())
+    }
+
+    /// Read from the read-only shadow of the ACPI space
+    unsafe fn read_acpi(&mut self, _addr: u8) -> Result<u8, Error> {
+        Err(Error::NotSupported)
+    }
+
+    /// Read from the ACPI space with the ACPI EC read command on the second host interface
+    /// (PMC2), which is not used by the OS ACPI driver
+    unsafe fn read_acpi_pmc2(&mut self, _addr: u8) -> Result<u8, Error> {
+        Err(Error::NotSupported)
+    }
+
+    /// Read from the read-only telemetry space
+    unsafe fn read_telemetry(&mut self, _addr: u8) -> Result<u8, Error> {
+        Err(Error::NotSupported)
+    }
+
+    /// Read consecutive bytes from the telemetry space, in increasing order
+    unsafe fn read_telemetry_block(&mut self, addr: u8, data: &mut [u8]) -> Result<(), Error> {
+        for i in 0..data.len() {
+            data[i] = self.read_telemetry(addr.wrapping_add(i as u8))?;
+        }
+        Ok(())
+    }
 }
 
 impl Access for Box<dyn Access> {
@@ -49,6 +81,26 @@ impl Access for Box<dyn Access> {
     unsafe fn read_debug(&mut self, addr: u8) -> Result<u8, Error> {
         (**self).read_debug(addr)
     }
+
+    unsafe fn read_debug_block(&mut self, addr: u8, data: &mut [u8]) -> Result<(), Error> {
+        (**self).read_debug_block(addr, data)
+    }
+
+    unsafe fn read_acpi(&mut self, addr: u8) -> Result<u8, Error> {
+        (**self).read_acpi(addr)
+    }
+
+    unsafe fn read_acpi_pmc2(&mut self, addr: u8) -> Result<u8, Error> {
+        (**self).read_acpi_pmc2(addr)
+    }
+
+    unsafe fn read_telemetry(&mut self, addr: u8) -> Result<u8, Error> {
+        (**self).read_telemetry(addr)
+    }
+
+    unsafe fn read_telemetry_block(&mut self, addr: u8, data: &mut [u8]) -> Result<(), Error> {
+        (**self).read_telemetry_block(addr, data)
+    }
 }
 
 downcast_rs::impl_downcast!(Access);
@@ -3,7 +3,9 @@
 #[cfg(not(feature = "std"))]
 use alloc::{
     boxed::Box,
+    string::String,
     vec,
+    vec::Vec,
 };
 use core::convert::TryFrom;
 
@@ -37,10 +39,22 @@ enum Cmd {
     MatrixGet = 17,
     LedSave = 18,
     SetNoInput = 19,
-    SecurityGet = 20,
-    SecuritySet = 21,
+    // FanCurveSet = 20,
+    SecurityGet = 21,
+    SecuritySet = 22,
+    // CameraEnablementSet = 23,
+    // WifiBtEnablementSet = 24,
+    // OptionGet = 25,
+    // OptionSet = 26,
+    ProfileGet = 27,
+    MatrixCalibrate = 28,
+    LatencyGet = 29,
+    AcpiStats = 30,
+    Batch = 31,
 }
 
+const CMD_PROBE_FEATURE_TELEMETRY: u8 = 1 << 0;
+
 const CMD_SPI_FLAG_READ: u8 = 1 << 0;
 const CMD_SPI_FLAG_DISABLE: u8 = 1 << 1;
 const CMD_SPI_FLAG_SCRATCH: u8 = 1 << 2;
@@ -73,19 +87,144 @@ impl TryFrom<u8> for SecurityState {
     }
 }
 
+/// Execution time profile of an EC main loop task
+#[derive(Clone, Debug)]
+pub struct Profile {
+    /// Index of the task
+    pub index: u8,
+    /// Number of tasks on the EC
+    pub count: u8,
+    /// Name of the task
+    pub name: String,
+    /// Execution time of the last run, in microseconds
+    pub last: u32,
+    /// Shortest execution time, in microseconds
+    pub min: u32,
+    /// Longest execution time, in microseconds
+    pub max: u32,
+    /// Average execution time, in microseconds
+    pub avg: u32,
+    /// Number of runs, saturating at 65535
+    pub runs: u16,
+    /// Percentage of time the EC was not idle over the last second
+    pub active: u8,
+}
+
+/// Action taken by a matrix settle time calibration command
+#[derive(Clone, Copy, Debug)]
+#[repr(u8)]
+pub enum MatrixCalibrateAction {
+    /// Report calibration state only
+    Get = 0,
+    /// Start measuring settle times
+    Start = 1,
+    /// Stop measuring and scan with the measured settle times
+    Apply = 2,
+    /// Stop measuring and keep the current settle times
+    Cancel = 3,
+}
+
+/// Keyboard matrix settle times, in timer ticks
+#[derive(Clone, Debug)]
+pub struct MatrixCalibration {
+    /// Calibration is running
+    pub calibrating: bool,
+    /// Time waited after driving all outputs
+    pub release: u8,
+    /// Time waited after selecting each output
+    pub settle: Vec<u8>,
+    /// Shortest reliable time measured for each output, if measured
+    pub calibration: Vec<Option<u8>>,
+}
+
+/// Keypress to host latency histogram
+#[derive(Clone, Debug)]
+pub struct Latency {
+    /// Upper bound of the first bucket, in microseconds. Each following
+    /// bucket doubles it, and the last bucket counts all longer latencies.
+    pub base: u16,
+    /// Longest latency, in microseconds
+    pub max: u32,
+    /// Number of key transitions in each bucket, saturating at 65535
+    pub histogram: Vec<u16>,
+    /// Number of key transitions that did not fit in the scancode buffer
+    pub overflow: u16,
+}
+
+/// ACPI traffic counters, wrapping
+#[derive(Clone, Copy, Debug)]
+pub struct AcpiStats {
+    /// ACPI read commands completed
+    pub reads: u32,
+    /// ACPI write commands completed
+    pub writes: u32,
+    /// SCI event queries
+    pub queries: u32,
+    /// SCI pulses requested
+    pub sci: u32,
+    /// SWI pulses requested
+    pub swi: u32,
+}
+
+/// Snapshot of EC state from the telemetry space
+#[derive(Clone, Copy, Debug)]
+pub struct Telemetry {
+    /// Time of the last update, in milliseconds since EC reset
+    pub time: u32,
+    /// ACPI power state
+    pub power_state: u8,
+    /// AC adapter is connected
+    pub ac: bool,
+    /// Lid is open
+    pub lid: bool,
+    /// CPU temperature, in degrees C
+    pub cpu_temp: i16,
+    /// dGPU temperature, in degrees C
+    pub dgpu_temp: i16,
+    /// Fan duty cycles, 0 to 255
+    pub fan_duty: [u8; 2],
+    /// Fan tachometer readings
+    pub fan_tach: [u16; 2],
+    /// Charger input current limit, in mA
+    pub charger_input_current: u16,
+    /// Battery voltage, in mV
+    pub battery_voltage: u16,
+    /// Battery current, in mA, positive while charging
+    pub battery_current: i16,
+    /// Battery charge, in percent
+    pub battery_charge: u16,
+    /// Battery remaining capacity, in mAh
+    pub battery_remaining_capacity: u16,
+    /// Battery full charge capacity, in mAh
+    pub battery_full_capacity: u16,
+    /// Battery status flags
+    pub battery_status: u16,
+}
+
+/// Layout version of the telemetry space
+const TELEMETRY_VERSION: u8 = 1;
+const TELEMETRY_SIZE: usize = 32;
+
 /// Run EC commands using a provided access method
 pub struct Ec<A: Access> {
     access: A,
     version: u8,
+    data_size: usize,
+    commands: Option<Vec<u8>>,
+    features: u8,
 }
 
 impl<A: Access> Ec<A> {
     /// Probes for a compatible EC
     pub unsafe fn new(access: A) -> Result<Self, Error> {
         // Create EC struct with provided access method and timeout
+        let data_size = access.data_size();
         let mut ec = Ec {
             access,
             version: 0,
+            data_size,
+            commands: None,
+            features: 0,
         };
 
         // Read version of protocol
@@ -112,19 +251,60 @@ impl<A: Access> Ec<A> {
         }
     }
 
-    /// Probe for EC
+    /// Probe for EC, and cache the data size, implemented commands, and features
     pub unsafe fn probe(&mut self) -> Result<u8, Error> {
-        let mut data = [0; 3];
+        // Signature, version, data size, a command bitmap of up to 32 bytes, and features
+        let mut data = vec![0; self.access.data_size().min(5 + 32 + 1)];
         self.command(Cmd::Probe, &mut data)?;
         let signature = (data[0], data[1]);
         if signature == (0x76, 0xEC) {
             let version = data[2];
+
+            // Older firmware leaves the rest of the data untouched
+            let data_size = data.get(3).map_or(0, |&x| x as usize);
+            if data_size != 0 {
+                self.data_size = data_size.min(self.access.data_size());
+            }
+            let bitmap_size = data.get(4).map_or(0, |&x| x as usize);
+            self.commands = data.get(5..5 + bitmap_size)
+                .filter(|bitmap| !bitmap.is_empty())
+                .map(|bitmap| bitmap.to_vec());
+            self.features = match self.commands {
+                Some(_) => data.get(5 + bitmap_size).map_or(0, |&x| x),
+                None => 0,
+            };
+
             Ok(version)
         } else {
             Err(Error::Signature(signature))
         }
     }
 
+    /// Maximum size of command data supported by both the EC and the access
+    /// method
+    pub fn data_size(&self) -> usize {
+        self.data_size
+    }
+
+    /// Returns true if the EC reported that it implements a command. Returns
+    /// false if the EC does not report its commands.
+    fn supports(&self, cmd: Cmd) -> bool {
+        let cmd = cmd as usize;
+        match &self.commands {
+            Some(bitmap) => bitmap.get(cmd / 8).map_or(false, |x| x & (1 << (cmd % 8)) != 0),
+            None => false,
+        }
+    }
+
+    /// Returns an error if the EC did not report that it implements a command
+    fn require(&self, cmd: Cmd) -> Result<(), Error> {
+        if self.supports(cmd) {
+            Ok(())
+        } else {
+            Err(Error::NotImplemented)
+        }
+    }
+
     /// Read board from EC
     pub unsafe fn board(&mut self, data: &mut [u8]) -> Result<usize, Error> {
         self.command(Cmd::Board, data)?;
@@ -327,12 +507,234 @@ impl<A: Access> Ec<A> {
        self.command(Cmd::SecuritySet, &mut data)
     }
 
+    /// Get execution time profile of a task by index
+    pub unsafe fn profile_get(&mut self, index: u8) -> Result<Profile, Error> {
+        self.require(Cmd::ProfileGet)?;
+        let mut data = vec![0; self.access.data_size()];
+        data[0] = index;
+        self.command(Cmd::ProfileGet, &mut data)?;
+
+        let u32_at = |i: usize| -> u32 {
+            (data[i] as u32) |
+            ((data[i + 1] as u32) << 8) |
+            ((data[i + 2] as u32) << 16) |
+            ((data[i + 3] as u32) << 24)
+        };
+
+        let mut name = String::new();
+        for &b in data[21..].iter() {
+            if b == 0 {
+                break;
+            }
+            name.push(b as char);
+        }
+
+        Ok(Profile {
+            index,
+            count: data[1],
+            name,
+            last: u32_at(2),
+            min: u32_at(6),
+            max: u32_at(10),
+            avg: u32_at(14),
+            runs: (data[18] as u16) | ((data[19] as u16) << 8),
+            active: data[20],
+        })
+    }
+
+    /// Run a keyboard matrix settle time calibration action
+    pub unsafe fn matrix_calibrate(&mut self, action: MatrixCalibrateAction) -> Result<MatrixCalibration, Error> {
+        let mut data = vec![0; self.access.data_size()];
+        data[0] = action as u8;
+        self.command(Cmd::MatrixCalibrate, &mut data)?;
+
+        let rows = data[2] as usize;
+        if 4 + 2 * rows > data.len() {
+            return Err(Error::Verify);
+        }
+
+        Ok(MatrixCalibration {
+            calibrating: data[1] != 0,
+            release: data[3],
+            settle: data[4..4 + rows].to_vec(),
+            calibration: data[4 + rows..4 + 2 * rows].iter().map(|&x| {
+                if x == 0xFF { None } else { Some(x) }
+            }).collect(),
+        })
+    }
+
+    /// Get keypress to host latency histogram, clearing it if requested
+    pub unsafe fn latency_get(&mut self, clear: bool) -> Result<Latency, Error> {
+        self.require(Cmd::LatencyGet)?;
+        let mut data = vec![0; self.access.data_size()];
+        data[0] = clear as u8;
+        self.command(Cmd::LatencyGet, &mut data)?;
+
+        let buckets = data[1] as usize;
+        let overflow = 8 + 2 * buckets;
+        if overflow + 2 > data.len() {
+            return Err(Error::Verify);
+        }
+
+        Ok(Latency {
+            base: (data[2] as u16) | ((data[3] as u16) << 8),
+            max: (data[4] as u32) |
+                ((data[5] as u32) << 8) |
+                ((data[6] as u32) << 16) |
+                ((data[7] as u32) << 24),
+            histogram: data[8..overflow].chunks(2).map(|x| {
+                (x[0] as u16) | ((x[1] as u16) << 8)
+            }).collect(),
+            overflow: (data[overflow] as u16) | ((data[overflow + 1] as u16) << 8),
+        })
+    }
+
+    /// Get ACPI traffic counters
+    pub unsafe fn acpi_stats(&mut self) -> Result<AcpiStats, Error> {
+        self.require(Cmd::AcpiStats)?;
+        let mut data = [0; 20];
+        self.command(Cmd::AcpiStats, &mut data)?;
+
+        let u32_at = |i: usize| -> u32 {
+            (data[i] as u32) |
+            ((data[i + 1] as u32) << 8) |
+            ((data[i + 2] as u32) << 16) |
+            ((data[i + 3] as u32) << 24)
+        };
+
+        Ok(AcpiStats {
+            reads: u32_at(0),
+            writes: u32_at(4),
+            queries: u32_at(8),
+            sci: u32_at(12),
+            swi: u32_at(16),
+        })
+    }
+
+    /// Read telemetry without running a command. Retries while the EC is
+    /// updating it.
+    pub unsafe fn telemetry(&mut self) -> Result<Telemetry, Error> {
+        if self.features & CMD_PROBE_FEATURE_TELEMETRY == 0 {
+            return Err(Error::NotImplemented);
+        }
+
+        let mut data = [0; TELEMETRY_SIZE];
+        for _attempt in 0..8 {
+            // The sequence at offset 1 is read before the data after it, so reading it again
+            // afterwards shows if the EC updated the page during the read
+            self.access.read_telemetry_block(0, &mut data)?;
+            let sequence = data[1];
+            if sequence & 1 != 0 {
+                continue;
+            }
+            if self.access.read_telemetry(1)? != sequence {
+                continue;
+            }
+
+            if data[0] != TELEMETRY_VERSION {
+                return Err(Error::Version(data[0]));
+            }
+
+            let u16_at = |i: usize| -> u16 {
+                (data[i] as u16) |
+                ((data[i + 1] as u16) << 8)
+            };
+
+            return Ok(Telemetry {
+                time: (u16_at(2) as u32) | ((u16_at(4) as u32) << 16),
+                power_state: data[6],
+                ac: data[7] & (1 << 0) != 0,
+                lid: data[7] & (1 << 1) != 0,
+                cpu_temp: u16_at(8) as i16,
+                dgpu_temp: u16_at(10) as i16,
+                fan_duty: [data[12], data[13]],
+                fan_tach: [u16_at(14), u16_at(16)],
+                charger_input_current: u16_at(18),
+                battery_voltage: u16_at(20),
+                battery_current: u16_at(22) as i16,
+                battery_charge: u16_at(24),
+                battery_remaining_capacity: u16_at(26),
+                battery_full_capacity: u16_at(28),
+                battery_status: u16_at(30),
+            });
+        }
+        Err(Error::Timeout)
+    }
+
+    /// Run several commands in one round trip. The data of each command is
+    /// replaced with its response, and the result of each command is returned.
+    unsafe fn batch(&mut self, commands: &mut [(Cmd, Vec<u8>)]) -> Result<Vec<u8>, Error> {
+        let mut data = vec![0; self.data_size];
+        if commands.len() > 255 {
+            return Err(Error::DataLength(commands.len()));
+        }
+        data[0] = commands.len() as u8;
+        let mut offset = 1;
+        for (cmd, payload) in commands.iter() {
+            let start = offset + 2;
+            let end = start + payload.len();
+            if payload.len() > 255 || end > data.len() {
+                return Err(Error::DataLength(end));
+            }
+            data[offset] = *cmd as u8;
+            data[offset + 1] = payload.len() as u8;
+            data[start..end].copy_from_slice(payload);
+            offset = end;
+        }
+
+        self.command(Cmd::Batch, &mut data)?;
+
+        let mut results = Vec::with_capacity(commands.len());
+        let mut offset = 1;
+        for (_cmd, payload) in commands.iter_mut() {
+            let start = offset + 2;
+            let end = start + payload.len();
+            results.push(data[offset]);
+            payload.copy_from_slice(&data[start..end]);
+            offset = end;
+        }
+        Ok(results)
+    }
+
+    /// Read keymap data of many keys by layout, output pin, and input pin, in
+    /// as few round trips as possible
+    pub unsafe fn keymap_get_many(&mut self, keys: &[(u8, u8, u8)]) -> Result<Vec<u16>, Error> {
+        // Batch count, then command, length, and data of each key
+        let per_batch = (self.data_size - 1) / (2 + 5);
+        let mut values = Vec::with_capacity(keys.len());
+        if !self.supports(Cmd::Batch) || per_batch == 0 {
+            for &(layer, output, input) in keys {
+                values.push(self.keymap_get(layer, output, input)?);
+            }
+            return Ok(values);
+        }
+
+        for chunk in keys.chunks(per_batch) {
+            let mut commands: Vec<(Cmd, Vec<u8>)> = chunk.iter().map(|&(layer, output, input)| {
+                (Cmd::KeymapGet, vec![layer, output, input, 0, 0])
+            }).collect();
+            let results = self.batch(&mut commands)?;
+            for (result, (_cmd, data)) in results.iter().zip(commands.iter()) {
+                if *result != 0 {
+                    return Err(Error::Protocol(*result));
+                }
+                values.push(
+                    (data[3] as u16) |
+                    ((data[4] as u16) << 8)
+                );
+            }
+        }
+        Ok(values)
+    }
+
     pub fn into_dyn(self) -> Ec<Box<dyn Access>>
     where A: 'static {
         Ec {
             access: Box::new(self.access),
             version: self.version,
-
+            data_size: self.data_size,
+            commands: self.commands,
+            features: self.features,
         }
     }
 }
@@ -7,6 +7,8 @@ pub enum Error {
     DataLength(usize),
     /// Operation not supported
     NotSupported,
+    /// EC firmware does not implement the command or feature
+    NotImplemented,
     /// A parameter was invalid
     Parameter,
     /// EC protocol returned an error result
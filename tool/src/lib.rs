@@ -9,7 +9,8 @@
 //!  - `AccessLpcDirect` requires the `redox_hwio` feature and a nightly compiler. This method is
 //!    only recommended for use in firmware with LPC ECs, as mutual exclusion is not guaranteed.
 //!  - `AccessLpcLinux` requires the `std` feature and `linux` target_os. Recommended for LPC ECs,
-//!    as this method can utilize mutual exclusion.
+//!    as this method can utilize mutual exclusion. `AccessLpcLinux::new_direct` uses port I/O
+//!    instead of `/dev/port`, with the same mutual exclusion, and requires an x86 target.
 //!  - `EcLegacy`, `Pmc`, and `SuperIo` all require the `redox_hwio` feature and a nightly
 //!    compiler. It is only recommended to use these in firmware, as mutual exclusion is not
 //!    guaranteed.
@@ -25,7 +26,7 @@ extern crate alloc;
 pub use self::access::*;
 mod access;
 
-pub use self::ec::{Ec, SecurityState};
+pub use self::ec::{AcpiStats, Ec, Latency, MatrixCalibrateAction, MatrixCalibration, Profile, SecurityState, Telemetry};
 mod ec;
 
 pub use self::error::Error;
@@ -34,6 +35,9 @@ mod error;
 pub use self::firmware::Firmware;
 mod firmware;
 
+pub use self::log::{LogDecoder, LogTokens};
+mod log;
+
 #[cfg(feature = "redox_hwio")]
 pub use self::legacy::EcLegacy;
 #[cfg(feature = "redox_hwio")]
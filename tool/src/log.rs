@@ -0,0 +1,505 @@
+// SPDX-License-Identifier: MIT
+
+//! Decoding of tokenized log output. The firmware sends a marker, the ID of the format string,
+//! and the arguments in binary, and the format strings are read from the dictionary generated
+//! by `scripts/log_tokens.py`.
+
+#[cfg(not(feature = "std"))]
+use alloc::{
+    collections::BTreeMap,
+    format,
+    string::String,
+    vec::Vec,
+};
+#[cfg(feature = "std")]
+use std::collections::BTreeMap;
+use core::fmt::Write;
+
+/// Start of a token, never used in text
+pub const LOG_TOKEN_MARKER: u8 = 0xFF;
+
+/// Kind of an argument, matching `common/log.h`
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
+enum LogArg {
+    Char,
+    Int,
+    Long,
+    LongLong,
+    Pointer,
+    String,
+}
+
+impl LogArg {
+    /// Size in bytes, or `None` for NUL terminated strings
+    fn size(self) -> Option<usize> {
+        match self {
+            LogArg::Char => Some(1),
+            LogArg::Int => Some(2),
+            LogArg::Long => Some(4),
+            LogArg::LongLong => Some(8),
+            LogArg::Pointer => Some(3),
+            LogArg::String => None,
+        }
+    }
+}
+
+/// Conversion in a format string
+#[derive(Clone, Debug)]
+struct Conversion {
+    left: bool,
+    zero: bool,
+    plus: bool,
+    space: bool,
+    width: usize,
+    precision: Option<usize>,
+    arg: LogArg,
+    kind: u8,
+}
+
+/// Piece of a format string
+#[derive(Clone, Debug)]
+enum Piece {
+    Text(String),
+    Conversion(Conversion),
+}
+
+fn parse_format(format: &str) -> Vec<Piece> {
+    let mut pieces = Vec::new();
+    let mut text = String::new();
+    let bytes = format.as_bytes();
+    let mut i = 0;
+    while i < bytes.len() {
+        if bytes[i] != b'%' {
+            // Copy up to the next conversion
+            let start = i;
+            while i < bytes.len() && bytes[i] != b'%' {
+                i += 1;
+            }
+            text.push_str(&format[start..i]);
+            continue;
+        }
+
+        let start = i;
+        i += 1;
+        let mut conversion = Conversion {
+            left: false,
+            zero: false,
+            plus: false,
+            space: false,
+            width: 0,
+            precision: None,
+            arg: LogArg::Int,
+            kind: 0,
+        };
+        while i < bytes.len() {
+            match bytes[i] {
+                b'-' => conversion.left = true,
+                b'0' => conversion.zero = true,
+                b'+' => conversion.plus = true,
+                b' ' => conversion.space = true,
+                b'#' => (),
+                _ => break,
+            }
+            i += 1;
+        }
+        while i < bytes.len() && bytes[i].is_ascii_digit() {
+            conversion.width = conversion.width * 10 + (bytes[i] - b'0') as usize;
+            i += 1;
+        }
+        if i < bytes.len() && bytes[i] == b'.' {
+            i += 1;
+            let mut precision = 0;
+            while i < bytes.len() && bytes[i].is_ascii_digit() {
+                precision = precision * 10 + (bytes[i] - b'0') as usize;
+                i += 1;
+            }
+            conversion.precision = Some(precision);
+        }
+        let rest = &bytes[i..];
+        if rest.starts_with(b"hh") || rest.starts_with(b"ll") {
+            if rest[0] == b'l' {
+                conversion.arg = LogArg::LongLong;
+            }
+            i += 2;
+        } else if rest.starts_with(b"h") {
+            i += 1;
+        } else if rest.starts_with(b"l") {
+            conversion.arg = LogArg::Long;
+            i += 1;
+        } else if rest.starts_with(b"b") {
+            conversion.arg = LogArg::Char;
+            i += 1;
+        }
+
+        match bytes.get(i) {
+            Some(b'%') => {
+                text.push('%');
+            },
+            Some(&kind) if b"diuxXoc".contains(&kind) => {
+                conversion.kind = kind;
+            },
+            Some(&kind) if kind == b's' || kind == b'S' => {
+                conversion.arg = LogArg::String;
+                conversion.kind = b's';
+            },
+            Some(b'p') => {
+                conversion.arg = LogArg::Pointer;
+                conversion.kind = b'p';
+            },
+            _ => {
+                // Not a conversion, the firmware ignores it too
+                text.push_str(&format[start..(i + 1).min(bytes.len())]);
+            },
+        }
+        i += 1;
+
+        if conversion.kind != 0 {
+            if !text.is_empty() {
+                pieces.push(Piece::Text(core::mem::take(&mut text)));
+            }
+            pieces.push(Piece::Conversion(conversion));
+        }
+    }
+    if !text.is_empty() {
+        pieces.push(Piece::Text(text));
+    }
+    pieces
+}
+
+/// Unescape a format string of the dictionary
+fn unescape(escaped: &str) -> String {
+    let mut string = String::new();
+    let mut chars = escaped.chars();
+    while let Some(c) = chars.next() {
+        if c != '\\' {
+            string.push(c);
+            continue;
+        }
+        match chars.next() {
+            Some('n') => string.push('\n'),
+            Some('r') => string.push('\r'),
+            Some('t') => string.push('\t'),
+            Some('x') => {
+                let hex: String = chars.by_ref().take(2).collect();
+                if let Ok(value) = u8::from_str_radix(&hex, 16) {
+                    string.push(value as char);
+                }
+            },
+            Some(c) => string.push(c),
+            None => (),
+        }
+    }
+    string
+}
+
+/// Format strings of a firmware build
+#[derive(Clone, Debug, Default)]
+pub struct LogTokens {
+    formats: BTreeMap<u16, Vec<Piece>>,
+}
+
+impl LogTokens {
+    /// Parse the dictionary generated with the firmware, with one `<id>\t<format>` line for each
+    /// format string
+    pub fn parse(dictionary: &str) -> Self {
+        let mut formats = BTreeMap::new();
+        for line in dictionary.lines() {
+            let mut parts = line.splitn(2, '\t');
+            let id = match parts.next().and_then(|x| x.parse::<u16>().ok()) {
+                Some(some) => some,
+                None => continue,
+            };
+            let format = unescape(parts.next().unwrap_or(""));
+            formats.insert(id, parse_format(&format));
+        }
+        Self { formats }
+    }
+
+    /// Number of format strings
+    pub fn len(&self) -> usize {
+        self.formats.len()
+    }
+
+    /// Returns true if there are no format strings
+    pub fn is_empty(&self) -> bool {
+        self.formats.is_empty()
+    }
+}
+
+/// State of the decoder
+enum State {
+    Text,
+    Id(Vec<u8>),
+    Args(u16, usize, Vec<Vec<u8>>, Vec<u8>),
+}
+
+/// Decoder of log output, fed one byte at a time
+pub struct LogDecoder {
+    tokens: LogTokens,
+    state: State,
+}
+
+impl LogDecoder {
+    pub fn new(tokens: LogTokens) -> Self {
+        Self {
+            tokens,
+            state: State::Text,
+        }
+    }
+
+    /// Discard any partial token, after a gap in the output. Bytes up to the next marker are
+    /// decoded as text
+    pub fn reset(&mut self) {
+        self.state = State::Text;
+    }
+
+    fn args(&self, id: u16) -> Vec<LogArg> {
+        match self.tokens.formats.get(&id) {
+            Some(pieces) => pieces.iter().filter_map(|piece| match piece {
+                Piece::Conversion(conversion) => Some(conversion.arg),
+                Piece::Text(_) => None,
+            }).collect(),
+            None => Vec::new(),
+        }
+    }
+
+    /// Decode a byte, writing any completed text to `output`
+    pub fn push(&mut self, byte: u8, output: &mut String) {
+        let state = core::mem::replace(&mut self.state, State::Text);
+        self.state = match state {
+            State::Text => if byte == LOG_TOKEN_MARKER {
+                State::Id(Vec::with_capacity(2))
+            } else {
+                output.push(byte as char);
+                State::Text
+            },
+            State::Id(mut id) => {
+                id.push(byte);
+                if id.len() < 2 {
+                    State::Id(id)
+                } else {
+                    let id = u16::from_le_bytes([id[0], id[1]]);
+                    self.next_arg(id, Vec::new(), output)
+                }
+            },
+            State::Args(id, index, mut args, mut arg) => {
+                arg.push(byte);
+                let done = match self.args(id)[index].size() {
+                    Some(size) => arg.len() >= size,
+                    None => byte == 0,
+                };
+                if done {
+                    args.push(arg);
+                    self.next_arg(id, args, output)
+                } else {
+                    State::Args(id, index, args, arg)
+                }
+            },
+        };
+    }
+
+    fn next_arg(&self, id: u16, args: Vec<Vec<u8>>, output: &mut String) -> State {
+        let index = args.len();
+        if index < self.args(id).len() {
+            State::Args(id, index, args, Vec::new())
+        } else {
+            self.format(id, &args, output);
+            State::Text
+        }
+    }
+
+    fn format(&self, id: u16, args: &[Vec<u8>], output: &mut String) {
+        let pieces = match self.tokens.formats.get(&id) {
+            Some(some) => some,
+            None => {
+                // Arguments are unknown, so the rest of the token is printed as text
+                let _ = write!(output, "<unknown log token {}>", id);
+                return;
+            },
+        };
+
+        let mut args = args.iter();
+        for piece in pieces.iter() {
+            match piece {
+                Piece::Text(text) => output.push_str(text),
+                Piece::Conversion(conversion) => {
+                    let arg = args.next().map(|x| x.as_slice()).unwrap_or(&[]);
+                    format_conversion(conversion, arg, output);
+                },
+            }
+        }
+    }
+}
+
+fn format_conversion(conversion: &Conversion, arg: &[u8], output: &mut String) {
+    let mut value: u64 = 0;
+    for (i, byte) in arg.iter().enumerate().take(8) {
+        value |= (*byte as u64) << (i * 8);
+    }
+    // Sign extend to 64 bits
+    let bits = (arg.len().min(8) * 8) as u32;
+    let signed = if bits == 0 || bits == 64 {
+        value as i64
+    } else {
+        ((value << (64 - bits)) as i64) >> (64 - bits)
+    };
+
+    let (sign, digits) = match conversion.kind {
+        b'd' | b'i' => {
+            let sign = if signed < 0 {
+                "-"
+            } else if conversion.plus {
+                "+"
+            } else if conversion.space {
+                " "
+            } else {
+                ""
+            };
+            (sign, format!("{}", signed.unsigned_abs()))
+        },
+        b'u' => ("", format!("{}", value)),
+        b'x' => ("", format!("{:x}", value)),
+        b'X' => ("", format!("{:X}", value)),
+        b'o' => ("", format!("{:o}", value)),
+        b'p' => ("", format!("{:06X}", value)),
+        b'c' => ("", format!("{}", value as u8 as char)),
+        _ => {
+            let end = arg.iter().position(|x| *x == 0).unwrap_or(arg.len());
+            let mut string: String = arg[..end].iter().map(|x| *x as char).collect();
+            if let Some(precision) = conversion.precision {
+                string.truncate(precision);
+            }
+            ("", string)
+        },
+    };
+
+    let len = sign.len() + digits.len();
+    let pad = conversion.width.saturating_sub(len);
+    if conversion.left {
+        output.push_str(sign);
+        output.push_str(&digits);
+        output.extend(core::iter::repeat(' ').take(pad));
+    } else if conversion.zero && conversion.kind != b's' && conversion.kind != b'c' {
+        output.push_str(sign);
+        output.extend(core::iter::repeat('0').take(pad));
+        output.push_str(&digits);
+    } else {
+        output.extend(core::iter::repeat(' ').take(pad));
+        output.push_str(sign);
+        output.push_str(&digits);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const DICTIONARY: &str = "1\tfan %d: %02X\\n\n\
+                              2\tname %s%%\n\
+                              3\t%-4lu|%+d|%5s|%c\n\
+                              4\tno args\\n\n";
+
+    fn decode(tokens: &LogTokens, bytes: &[u8]) -> String {
+        let mut decoder = LogDecoder::new(tokens.clone());
+        let mut output = String::new();
+        for &byte in bytes.iter() {
+            decoder.push(byte, &mut output);
+        }
+        output
+    }
+
+    #[test]
+    fn parse_format_args() {
+        let args: Vec<LogArg> = parse_format("%d %ld %lld %hhx %bx %s %p %% %u")
+            .into_iter()
+            .filter_map(|piece| match piece {
+                Piece::Conversion(conversion) => Some(conversion.arg),
+                Piece::Text(_) => None,
+            })
+            .collect();
+        assert_eq!(args, vec![
+            LogArg::Int,
+            LogArg::Long,
+            LogArg::LongLong,
+            LogArg::Int,
+            LogArg::Char,
+            LogArg::String,
+            LogArg::Pointer,
+            LogArg::Int,
+        ]);
+    }
+
+    #[test]
+    fn parse_format_text() {
+        let pieces = parse_format("100%% %q done");
+        assert_eq!(pieces.len(), 1);
+        match &pieces[0] {
+            Piece::Text(text) => assert_eq!(text, "100% %q done"),
+            Piece::Conversion(_) => panic!("unexpected conversion"),
+        }
+    }
+
+    #[test]
+    fn parse_dictionary() {
+        let tokens = LogTokens::parse("1\ta\\tb\\x41\\\\\nbad line\n2\t\n");
+        assert_eq!(tokens.len(), 2);
+        assert_eq!(decode(&tokens, &[LOG_TOKEN_MARKER, 1, 0]), "a\tbA\\");
+        assert_eq!(decode(&tokens, &[LOG_TOKEN_MARKER, 2, 0]), "");
+    }
+
+    #[test]
+    fn decode_tokens() {
+        let tokens = LogTokens::parse(DICTIONARY);
+        assert_eq!(tokens.len(), 4);
+
+        // Text passes through around tokens
+        assert_eq!(
+            decode(&tokens, b"ok\n\xFF\x04\x00after"),
+            "ok\nno args\nafter"
+        );
+
+        // Sign extension of ints, and zero padding
+        assert_eq!(
+            decode(&tokens, &[LOG_TOKEN_MARKER, 1, 0, 0xFE, 0xFF, 0x0A, 0x00]),
+            "fan -2: 0A\n"
+        );
+
+        // Strings end with their NUL
+        assert_eq!(
+            decode(&tokens, b"\xFF\x02\x00ec\x00"),
+            "name ec%"
+        );
+
+        // Width, alignment, and sign
+        assert_eq!(
+            decode(&tokens, b"\xFF\x03\x00\x07\x00\x00\x00\x05\x00ab\x00Z\x00"),
+            "7   |+5|   ab|Z"
+        );
+    }
+
+    #[test]
+    fn decode_unknown() {
+        let tokens = LogTokens::parse(DICTIONARY);
+        assert_eq!(
+            decode(&tokens, &[LOG_TOKEN_MARKER, 9, 0, b'x']),
+            "<unknown log token 9>x"
+        );
+    }
+
+    #[test]
+    fn decode_reset() {
+        let tokens = LogTokens::parse(DICTIONARY);
+        let mut decoder = LogDecoder::new(tokens);
+        let mut output = String::new();
+
+        // A token cut short by a gap is dropped, and decoding resumes as text
+        for &byte in [LOG_TOKEN_MARKER, 1, 0, 0x05].iter() {
+            decoder.push(byte, &mut output);
+        }
+        decoder.reset();
+        for &byte in b"text\xFF\x04\x00".iter() {
+            decoder.push(byte, &mut output);
+        }
+        assert_eq!(output, "textno args\n");
+    }
+}
@@ -9,6 +9,9 @@ use ectool::{
     Ec,
     Error,
     Firmware,
+    LogDecoder,
+    LogTokens,
+    MatrixCalibrateAction,
     SecurityState,
     StdTimeout,
     Spi,
@@ -20,30 +23,147 @@ use std::{
     fs,
     process,
     str,
-    time::Duration,
+    time::{Duration, Instant},
     thread,
 };
 
-unsafe fn console(ec: &mut Ec<Box<dyn Access>>) -> Result<(), Error> {
+// Layout of the debug ring header, see smfi.c
+const DEBUG_SIGNATURE: [u8; 2] = [0x76, 0xEC];
+const DEBUG_SIZE: usize = 2;
+const DEBUG_SEQUENCE: u8 = 4;
+const DEBUG_DROPPED: usize = 8;
+const DEBUG_DATA: u8 = 16;
+
+unsafe fn console_sequence(access: &mut Box<dyn Access>) -> Result<u32, Error> {
+    // The EC may update the sequence while it is read, so read until it is stable
+    let mut last = [0; 4];
+    access.read_debug_block(DEBUG_SEQUENCE, &mut last)?;
+    loop {
+        let mut sequence = [0; 4];
+        access.read_debug_block(DEBUG_SEQUENCE, &mut sequence)?;
+        if sequence == last {
+            return Ok(u32::from_le_bytes(sequence));
+        }
+        last = sequence;
+    }
+}
+
+unsafe fn console(ec: &mut Ec<Box<dyn Access>>, tokens: Option<LogTokens>) -> Result<(), Error> {
     //TODO: driver support for reading debug region?
     let access = ec.access();
+    let mut decoder = tokens.map(LogDecoder::new);
+    let mut text = String::new();
+    // Print bytes, after a gap in the output if gap is set
+    let mut print = |data: &[u8], gap: bool| {
+        if let Some(ref mut decoder) = decoder {
+            if gap {
+                // Bytes after the gap may be in the middle of a token
+                decoder.reset();
+            }
+        }
+        for &c in data.iter() {
+            match decoder {
+                Some(ref mut decoder) => decoder.push(c, &mut text),
+                None => text.push(c as char),
+            }
+        }
+        print!("{}", text);
+        text.clear();
+    };
 
-    let mut head = access.read_debug(0)? as usize;
+    let mut header = [0; DEBUG_DATA as usize];
+    access.read_debug_block(0, &mut header)?;
+    if header[..2] != DEBUG_SIGNATURE {
+        // Older firmware only has a tail at the start of the ring
+        let mut head = header[0] as usize;
+        loop {
+            let tail = access.read_debug(0)? as usize;
+            if tail == 0 || head == tail {
+                thread::sleep(Duration::from_millis(1));
+            } else {
+                while head != tail {
+                    head += 1;
+                    if head >= 256 { head = 1; }
+                    let c = access.read_debug(head as u8)?;
+                    print(&[c], false);
+                }
+            }
+        }
+    }
+
+    let size = header[DEBUG_SIZE] as u32;
+    if size == 0 {
+        return Err(Error::Verify);
+    }
+    let mut dropped = u16::from_le_bytes([header[DEBUG_DROPPED], header[DEBUG_DROPPED + 1]]);
+    let mut head = console_sequence(access)?;
+    let mut data = vec![0; size as usize];
     loop {
-        let tail = access.read_debug(0)? as usize;
-        if tail == 0 || head == tail {
+        let sequence = console_sequence(access)?;
+        let mut count = sequence.wrapping_sub(head);
+        if count == 0 {
             thread::sleep(Duration::from_millis(1));
-        } else {
-            while head != tail {
-                head += 1;
-                if head >= 256 { head = 1; }
-                let c = access.read_debug(head as u8)?;
-                print!("{}", c as char);
-            }
+            continue;
+        }
+
+        let mut lost = 0;
+        if count > size {
+            // Overwritten before this poll
+            lost += count - size;
+            head = sequence.wrapping_sub(size);
+            count = size;
+        }
+
+        // Read new bytes, in two parts if they wrap around the end of the ring
+        let start = head % size;
+        let first = count.min(size - start);
+        access.read_debug_block(DEBUG_DATA + start as u8, &mut data[..first as usize])?;
+        access.read_debug_block(DEBUG_DATA, &mut data[first as usize..count as usize])?;
+
+        // Skip bytes overwritten while reading
+        let skip = console_sequence(access)?.wrapping_sub(head).saturating_sub(size).min(count);
+        lost += skip;
+
+        let mut bytes = [0; 2];
+        access.read_debug_block(DEBUG_DROPPED as u8, &mut bytes)?;
+        let ec_dropped = u16::from_le_bytes(bytes);
+        let gap = lost > 0 || ec_dropped != dropped;
+        if gap {
+            eprintln!(
+                "\n[{} bytes lost, {} bytes dropped by EC]",
+                lost,
+                ec_dropped.wrapping_sub(dropped)
+            );
+            dropped = ec_dropped;
         }
+
+        print(&data[skip as usize..count as usize], gap);
+        head = head.wrapping_add(count);
     }
 }
 
+unsafe fn acpi(ec: &mut Ec<Box<dyn Access>>, pmc2: bool) -> Result<(), Error> {
+    // Read the shadow directly, without going through the ACPI EC interface, or
+    // use the ACPI EC interface of PMC2
+    let access = ec.access();
+
+    for row in 0..16 {
+        print!("{:02X}:", row * 16);
+        for col in 0..16 {
+            let addr = (row * 16 + col) as u8;
+            let value = if pmc2 {
+                access.read_acpi_pmc2(addr)?
+            } else {
+                access.read_acpi(addr)?
+            };
+            print!(" {:02X}", value);
+        }
+        println!();
+    }
+
+    Ok(())
+}
+
 unsafe fn flash_read<S: Spi>(spi: &mut SpiRom<S, StdTimeout>, rom: &mut [u8], sector_size: usize) -> Result<(), Error> {
     let mut address = 0;
     while address < rom.len() {
@@ -217,6 +337,8 @@ unsafe fn info(ec: &mut Ec<Box<dyn Access>>) -> Result<(), Error> {
         println!();
     }
 
+    println!("data size: {}", ec.data_size());
+
     Ok(())
 }
 
@@ -249,6 +371,186 @@ unsafe fn matrix(ec: &mut Ec<Box<dyn Access>>) -> Result<(), Error> {
     Ok(())
 }
 
+unsafe fn keymap_dump(ec: &mut Ec<Box<dyn Access>>, layer: u8) -> Result<(), Error> {
+    let data_size = ec.access().data_size();
+
+    let mut data = vec![0; data_size];
+    ec.matrix_get(&mut data)?;
+    let rows = *data.get(0).unwrap_or(&0);
+    let cols = *data.get(1).unwrap_or(&0);
+
+    let mut keys = Vec::new();
+    for output in 0..rows {
+        for input in 0..cols {
+            keys.push((layer, output, input));
+        }
+    }
+    let values = ec.keymap_get_many(&keys)?;
+    for row in values.chunks(cols.max(1) as usize) {
+        for value in row {
+            print!(" {:04X}", value);
+        }
+        println!();
+    }
+
+    Ok(())
+}
+
+unsafe fn matrix_calibrate(ec: &mut Ec<Box<dyn Access>>, action: MatrixCalibrateAction) -> Result<(), Error> {
+    let calibration = ec.matrix_calibrate(action)?;
+
+    println!("calibrating: {}", calibration.calibrating);
+    println!("release: {}", calibration.release);
+    println!("{:<4} {:>7} {:>9}", "row", "settle", "measured");
+    for (row, (settle, measured)) in calibration.settle.iter().zip(calibration.calibration.iter()).enumerate() {
+        match measured {
+            Some(measured) => println!("{:<4} {:>7} {:>9}", row, settle, measured),
+            None => println!("{:<4} {:>7} {:>9}", row, settle, "-"),
+        }
+    }
+
+    Ok(())
+}
+
+unsafe fn acpi_stats(ec: &mut Ec<Box<dyn Access>>) -> Result<(), Error> {
+    // Sample twice to measure the rate
+    let first = ec.acpi_stats()?;
+    thread::sleep(Duration::from_secs(1));
+    let second = ec.acpi_stats()?;
+
+    println!("{:<8} {:>10} {:>8}", "counter", "total", "per sec");
+    for (name, first, second) in [
+        ("reads", first.reads, second.reads),
+        ("writes", first.writes, second.writes),
+        ("queries", first.queries, second.queries),
+        ("sci", first.sci, second.sci),
+        ("swi", first.swi, second.swi),
+    ].iter() {
+        println!("{:<8} {:>10} {:>8}", name, second, second.wrapping_sub(*first));
+    }
+
+    Ok(())
+}
+
+unsafe fn telemetry(ec: &mut Ec<Box<dyn Access>>) -> Result<(), Error> {
+    let telemetry = ec.telemetry()?;
+
+    println!("time: {} ms", telemetry.time);
+    println!("power state: {:02X}", telemetry.power_state);
+    println!("ac: {}", telemetry.ac);
+    println!("lid: {}", telemetry.lid);
+    println!("cpu temp: {} C", telemetry.cpu_temp);
+    println!("dgpu temp: {} C", telemetry.dgpu_temp);
+    for (i, (duty, tach)) in telemetry.fan_duty.iter().zip(telemetry.fan_tach.iter()).enumerate() {
+        println!("fan {}: duty {} tach {}", i, duty, tach);
+    }
+    println!("charger input current: {} mA", telemetry.charger_input_current);
+    println!("battery voltage: {} mV", telemetry.battery_voltage);
+    println!("battery current: {} mA", telemetry.battery_current);
+    println!("battery charge: {}%", telemetry.battery_charge);
+    println!("battery remaining capacity: {} mAh", telemetry.battery_remaining_capacity);
+    println!("battery full capacity: {} mAh", telemetry.battery_full_capacity);
+    println!("battery status: {:04X}", telemetry.battery_status);
+
+    Ok(())
+}
+
+unsafe fn latency(ec: &mut Ec<Box<dyn Access>>, clear: bool) -> Result<(), Error> {
+    let latency = ec.latency_get(clear)?;
+    let ms = |us: u32| -> f64 {
+        (us as f64) / 1000.0
+    };
+
+    println!("{:>12} {:>8}", "below (ms)", "count");
+    let last = latency.histogram.len().saturating_sub(1);
+    for (bucket, count) in latency.histogram.iter().enumerate() {
+        if bucket < last {
+            let below = (latency.base as u32) << bucket;
+            println!("{:>12.3} {:>8}", ms(below), count);
+        } else {
+            println!("{:>12} {:>8}", "-", count);
+        }
+    }
+    println!("max: {:.3} ms", ms(latency.max));
+    println!("overflow: {}", latency.overflow);
+
+    Ok(())
+}
+
+unsafe fn bench(ec: &mut Ec<Box<dyn Access>>, count: u32, spi: bool) -> Result<(), Error> {
+    let report = |name: &str, start: Instant| {
+        let us = start.elapsed().as_secs_f64() * 1000000.0;
+        println!("{}: {} in {:.0} us, {:.1} us each", name, count, us, us / (count as f64));
+    };
+
+    let start = Instant::now();
+    for _ in 0..count {
+        ec.probe()?;
+    }
+    report("probe", start);
+
+    if spi {
+        // Reading the ROM requires scratch ROM, which runs until the EC is reset
+        let mut data = vec![0; ec.access().data_size() - 2];
+        let res = {
+            let mut spi_bus = ec.spi(SpiTarget::Main, true)?;
+            let mut spi = SpiRom::new(
+                &mut spi_bus,
+                StdTimeout::new(Duration::new(1, 0))
+            );
+            let start = Instant::now();
+            let mut res = Ok(());
+            for _ in 0..count {
+                if let Err(err) = spi.read_at(0, &mut data) {
+                    res = Err(err);
+                    break;
+                }
+            }
+            if res.is_ok() {
+                report(&format!("spi read of {} bytes", data.len()), start);
+            }
+            res
+        };
+
+        eprintln!("System will shut off in 5 seconds");
+        thread::sleep(Duration::new(5, 0));
+        ec.reset()?;
+
+        res?;
+    }
+
+    Ok(())
+}
+
+unsafe fn profile(ec: &mut Ec<Box<dyn Access>>) -> Result<(), Error> {
+    let ms = |us: u32| -> f64 {
+        (us as f64) / 1000.0
+    };
+
+    println!("{:<10} {:>10} {:>10} {:>10} {:>10} {:>6}", "task", "last (ms)", "min (ms)", "max (ms)", "avg (ms)", "runs");
+    let mut index = 0;
+    loop {
+        let profile = ec.profile_get(index)?;
+        println!(
+            "{:<10} {:>10.3} {:>10.3} {:>10.3} {:>10.3} {:>6}",
+            profile.name,
+            ms(profile.last),
+            ms(profile.min),
+            ms(profile.max),
+            ms(profile.avg),
+            profile.runs,
+        );
+
+        index += 1;
+        if index >= profile.count {
+            println!("active: {}%", profile.active);
+            break;
+        }
+    }
+
+    Ok(())
+}
+
 unsafe fn print(ec: &mut Ec<Box<dyn Access>>, message: &[u8]) -> Result<(), Error> {
     ec.print(message)?;
 
@@ -305,10 +607,21 @@ fn main() {
         .setting(AppSettings::SubcommandRequired)
         .arg(Arg::with_name("access")
             .long("access")
-            .possible_values(&["lpc-linux", "lpc-sim", "hid"])
+            .possible_values(&["lpc-linux", "lpc-direct", "lpc-sim", "hid"])
             .default_value("lpc-linux")
         )
-        .subcommand(SubCommand::with_name("console"))
+        .subcommand(SubCommand::with_name("acpi")
+            .arg(Arg::with_name("pmc2")
+                .long("pmc2")
+                .help("Read with ACPI EC commands on PMC2 instead of the shadow")
+            )
+        )
+        .subcommand(SubCommand::with_name("console")
+            .arg(Arg::with_name("tokens")
+                .long("tokens")
+                .takes_value(true)
+                .help("Decode tokenized log messages with the log_tokens.txt of the firmware build"))
+        )
         .subcommand(SubCommand::with_name("fan")
             .arg(Arg::with_name("index")
                 .allow_invalid_utf8(true)
@@ -350,6 +663,12 @@ fn main() {
             )
             .arg(Arg::with_name("value"))
         )
+        .subcommand(SubCommand::with_name("keymap_dump")
+            .arg(Arg::with_name("layer")
+                .value_parser(clap::value_parser!(u8))
+                .required(true)
+            )
+        )
         .subcommand(SubCommand::with_name("led_color")
             .arg(Arg::with_name("index")
                 .value_parser(clap::value_parser!(u8))
@@ -381,8 +700,35 @@ fn main() {
                 .value_parser(clap::value_parser!(u8))
             )
         )
+        .subcommand(SubCommand::with_name("bench")
+            .arg(Arg::with_name("count")
+                .long("count")
+                .takes_value(true)
+                .default_value("1000")
+                .value_parser(clap::value_parser!(u32))
+                .help("Number of round trips to time")
+            )
+            .arg(Arg::with_name("spi")
+                .long("spi")
+                .help("Also time SPI ROM reads. These run from scratch ROM, so the system is shut off afterwards")
+            )
+        )
         .subcommand(SubCommand::with_name("led_save"))
+        .subcommand(SubCommand::with_name("acpi_stats"))
+        .subcommand(SubCommand::with_name("latency")
+            .arg(Arg::with_name("clear")
+                .long("clear")
+                .help("Clear the histogram after reading it")
+            )
+        )
         .subcommand(SubCommand::with_name("matrix"))
+        .subcommand(SubCommand::with_name("matrix_calibrate")
+            .arg(Arg::with_name("action")
+                .possible_values(&["start", "apply", "cancel"])
+            )
+        )
+        .subcommand(SubCommand::with_name("profile"))
+        .subcommand(SubCommand::with_name("telemetry"))
         .subcommand(SubCommand::with_name("print")
             .arg(Arg::with_name("message")
                 .required(true)
@@ -409,6 +755,10 @@ fn main() {
                     let access = AccessLpcLinux::new(Duration::new(1, 0))?;
                     Ok(Ec::new(access)?.into_dyn())
                 },
+                "lpc-direct" => {
+                    let access = AccessLpcLinux::new_direct(Duration::new(1, 0))?;
+                    Ok(Ec::new(access)?.into_dyn())
+                },
                 "lpc-sim" => {
                     let access = AccessLpcSim::new(Duration::new(1, 0))?;
                     Ok(Ec::new(access)?.into_dyn())
@@ -448,13 +798,31 @@ fn main() {
     };
 
     match matches.subcommand() {
-        Some(("console", _sub_m)) => match unsafe { console(&mut ec) } {
+        Some(("acpi", sub_m)) => match unsafe { acpi(&mut ec, sub_m.is_present("pmc2")) } {
             Ok(()) => (),
             Err(err) => {
-                eprintln!("failed to read console: {:X?}", err);
+                eprintln!("failed to read ACPI space: {:X?}", err);
                 process::exit(1);
             },
         },
+        Some(("console", sub_m)) => {
+            let tokens = sub_m.value_of("tokens").map(|path| {
+                match fs::read_to_string(path) {
+                    Ok(dictionary) => LogTokens::parse(&dictionary),
+                    Err(err) => {
+                        eprintln!("failed to read log tokens '{}': {}", path, err);
+                        process::exit(1);
+                    },
+                }
+            });
+            match unsafe { console(&mut ec, tokens) } {
+                Ok(()) => (),
+                Err(err) => {
+                    eprintln!("failed to read console: {:X?}", err);
+                    process::exit(1);
+                },
+            }
+        },
         Some(("fan", sub_m)) => {
             let index = sub_m.value_of_os("index").unwrap().to_string_lossy().parse::<u8>().unwrap();
             let duty_opt = sub_m.value_of("duty").map(|x| x.parse::<u8>().unwrap());
@@ -532,6 +900,16 @@ fn main() {
                 },
             }
         },
+        Some(("keymap_dump", sub_m)) => {
+            let layer = sub_m.value_of("layer").unwrap().parse::<u8>().unwrap();
+            match unsafe { keymap_dump(&mut ec, layer) } {
+                Ok(()) => (),
+                Err(err) => {
+                    eprintln!("failed to dump keymap layer {}: {:X?}", layer, err);
+                    process::exit(1);
+                },
+            }
+        },
         Some(("led_color", sub_m)) => {
             let index = sub_m.value_of("index").unwrap().parse::<u8>().unwrap();
             let value = sub_m.value_of("value");
@@ -603,6 +981,16 @@ fn main() {
                 }
             }
         },
+        Some(("bench", sub_m)) => {
+            let count = sub_m.value_of("count").unwrap().parse::<u32>().unwrap();
+            match unsafe { bench(&mut ec, count, sub_m.is_present("spi")) } {
+                Ok(()) => (),
+                Err(err) => {
+                    eprintln!("failed to run benchmark: {:X?}", err);
+                    process::exit(1);
+                },
+            }
+        },
         Some(("led_save", _sub_m)) => match unsafe { ec.led_save() } {
             Ok(()) => (),
             Err(err) => {
@@ -610,6 +998,28 @@ fn main() {
                 process::exit(1);
             },
         },
+        Some(("acpi_stats", _sub_m)) => match unsafe { acpi_stats(&mut ec) } {
+            Ok(()) => (),
+            Err(Error::NotImplemented) => {
+                eprintln!("failed to read ACPI stats: not supported by this firmware");
+                process::exit(1);
+            },
+            Err(err) => {
+                eprintln!("failed to read ACPI stats: {:X?}", err);
+                process::exit(1);
+            },
+        },
+        Some(("latency", sub_m)) => match unsafe { latency(&mut ec, sub_m.is_present("clear")) } {
+            Ok(()) => (),
+            Err(Error::NotImplemented) => {
+                eprintln!("failed to read latency: not supported by this firmware");
+                process::exit(1);
+            },
+            Err(err) => {
+                eprintln!("failed to read latency: {:X?}", err);
+                process::exit(1);
+            },
+        },
         Some(("matrix", _sub_m)) => match unsafe { matrix(&mut ec) } {
             Ok(()) => (),
             Err(err) => {
@@ -617,6 +1027,43 @@ fn main() {
                 process::exit(1);
             },
         },
+        Some(("matrix_calibrate", sub_m)) => {
+            let action = match sub_m.value_of("action") {
+                Some("start") => MatrixCalibrateAction::Start,
+                Some("apply") => MatrixCalibrateAction::Apply,
+                Some("cancel") => MatrixCalibrateAction::Cancel,
+                _ => MatrixCalibrateAction::Get,
+            };
+            match unsafe { matrix_calibrate(&mut ec, action) } {
+                Ok(()) => (),
+                Err(err) => {
+                    eprintln!("failed to calibrate matrix: {:X?}", err);
+                    process::exit(1);
+                },
+            }
+        },
+        Some(("profile", _sub_m)) => match unsafe { profile(&mut ec) } {
+            Ok(()) => (),
+            Err(Error::NotImplemented) => {
+                eprintln!("failed to read profile: not supported by this firmware");
+                process::exit(1);
+            },
+            Err(err) => {
+                eprintln!("failed to read profile: {:X?}", err);
+                process::exit(1);
+            },
+        },
+        Some(("telemetry", _sub_m)) => match unsafe { telemetry(&mut ec) } {
+            Ok(()) => (),
+            Err(Error::NotImplemented) => {
+                eprintln!("failed to read telemetry: not supported by this firmware");
+                process::exit(1);
+            },
+            Err(err) => {
+                eprintln!("failed to read telemetry: {:X?}", err);
+                process::exit(1);
+            },
+        },
         Some(("print", sub_m)) => for arg in sub_m.values_of("message").unwrap() {
             let mut arg = arg.to_owned();
             arg.push('\n');